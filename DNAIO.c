@@ -34,6 +34,7 @@
 #include "crc.h"
 #include "str_match.h"
 #include "xml.h"
+#include "blockio.h"
 
 #define MY_ENCODING "ISO-8859-1"
 
@@ -123,17 +124,21 @@ static char bin2DNA ( char *src, char *dest ){
  * Parse the assembled DNA blocks, remove the version tags as well as
  * recombination repeats, check the CRC signature, and write to binary blocks
  */
-static void parse_DNA_blocks ( char *source_file, char *output_file){
+static void parse_DNA_blocks ( char *source_file, char *output_file, int packed){
 	char temp_fname[32];
 	char temp_str[65536];
 	char temp_bin[65536];
+	char temp_bits[65536];
+	int block_len=-1;
+	long n_blocks=0, correct_header, last_addr=0;
 	char block_pos[80],header_crc[80],header_crc2[80],data_crc[80],data_crc2[80];
 
 	char *p;
 
 	FILE *srcf, *encf, *tmpf;
 	char c;
-	int i, j=0, n,k, line=0,last_addr=0 ;
+	int i, j=0, n,k;
+	long line=0;
 	crc_t crc;
 
 	/* Open source file. */
@@ -166,7 +171,7 @@ static void parse_DNA_blocks ( char *source_file, char *output_file){
 			//Remove newline character
 			temp_str[strlen(temp_str)-1]='\0';
 			//Check if version tags match
-			char c[strlen(version_5prime_DNA)];
+			char c[strlen(version_5prime_DNA)+1];
 			int dist5=0, dist3=0;
 			strncpy(c,temp_str,strlen(version_5prime_DNA));
 			c[strlen(version_5prime_DNA)]='\0';
@@ -251,9 +256,10 @@ static void parse_DNA_blocks ( char *source_file, char *output_file){
 			}
 			temp_bin[i*2+2]='\0';
 
-			//Try to match the block position to its CRC signature
-			int correct_header=-1;
-			for (j=1;j<16;j++){
+			//Try to match the block position to its CRC signature, which
+			//always has an even number of bits, as many as 62 of them
+			correct_header=-1;
+			for (j=2;j<=62;j+=2){
 				strncpy(block_pos,temp_bin,j);
 				block_pos[j]='\0';
 				strncpy(header_crc,temp_bin+j,32);
@@ -263,7 +269,7 @@ static void parse_DNA_blocks ( char *source_file, char *output_file){
 				crc = crc_finalize(crc);
 				int2bin(crc,header_crc2);
 				if (strcmp(header_crc,header_crc2)==0){
-					fprintf(stderr,"Correct header checksum found at block %d! \n",line);
+					fprintf(stderr,"Correct header checksum found at block %ld! \n",line);
 					correct_header=bin2dec(block_pos);
 					break;
 				}
@@ -279,21 +285,36 @@ static void parse_DNA_blocks ( char *source_file, char *output_file){
 				temp_bin[strlen(temp_bin)-32]='\n';
 				temp_bin[strlen(temp_bin)-31]='\0';
 
-				//Write the block
-				fputs(temp_bin, encf);
+				//Write the block, packed unless text was asked for
+				if (packed){
+					n=strlen(temp_bin)-1;
+					if (block_len<0){
+						block_len=n;
+						blockio_write_header(encf,block_len);
+					}else if (n!=block_len){
+						fprintf(stderr,"Block %ld has length %d, not %d!\n",line,n,block_len);
+						exit(1);
+					}
+					for (k=0;k<n;k++) temp_bits[k]=temp_bin[k]=='1';
+					blockio_write_packed(encf,temp_bits,n);
+				}else{
+					fputs(temp_bin, encf);
+				}
+				n_blocks++;
 				if (ferror(encf))
 				{ fprintf(stderr,"Error writing block output file\n");
 				exit(1);
-				}else{ fprintf(stderr,"\tBlock %d data extracted!\n",line);}
+				}else{ fprintf(stderr,"\tBlock %ld data extracted!\n",line);}
 
 			}
 			else{
-				fprintf(stderr,"Can't find proper address at line %d!\n",line);
+				fprintf(stderr,"Can't find proper address at line %ld!\n",line);
 				exit(1);
 			}
 		}
 	}
 
+	if (packed && block_len>=0) blockio_write_count(encf,n_blocks);
 	if (fclose(encf)!=0) fprintf(stderr,"Error closing output file!\n");
 }
 
@@ -314,7 +335,8 @@ static void convert_xml(char *source_file, char *output_file, int mode)
 	char meta_tags[64][32], meta_values[64][1024];
 
 	// Data for each block
-	char header_version[65], pos[34], header_checksum[34], data[2049], data_checksum[34], footer_version[65];
+	char header_version[Xml_max_version+1], pos[Xml_max_pos+1], header_checksum[Xml_max_checksum+1];
+	char data[Xml_max_data+1], data_checksum[Xml_max_checksum+1], footer_version[Xml_max_version+1];
 	char buf[4097];
 	int i, type, ret, rc; //ret for xmlTextReader, rc for xmlTextWriter
 
@@ -406,32 +428,32 @@ static void convert_xml(char *source_file, char *output_file, int mode)
 				/* From DNA to binary. */
 				if (mode==1){
 					DNA2bin(header_version, buf);
-					strncpy(header_version, buf, 65);
+					snprintf(header_version, sizeof header_version, "%s", buf);
 					DNA2bin(pos, buf);
-					strncpy(pos, buf, 34);
+					snprintf(pos, sizeof pos, "%s", buf);
 					DNA2bin(header_checksum, buf);
-					strncpy(header_checksum, buf, 34);
+					snprintf(header_checksum, sizeof header_checksum, "%s", buf);
 					DNA2bin(data, buf);
-					strncpy(data, buf, 2049);
+					snprintf(data, sizeof data, "%s", buf);
 					DNA2bin(data_checksum, buf);
-					strncpy(data_checksum, buf, 34);
+					snprintf(data_checksum, sizeof data_checksum, "%s", buf);
 					DNA2bin(footer_version, buf);
-					strncpy(footer_version, buf, 65);
+					snprintf(footer_version, sizeof footer_version, "%s", buf);
 				}
 				/* From binary to DNA. */
 				else if (mode==2 || mode==3){
 					bin2DNA(header_version, buf);
-					strncpy(header_version, buf, 65);
+					snprintf(header_version, sizeof header_version, "%s", buf);
 					bin2DNA(pos, buf);
-					strncpy(pos, buf, 34);
+					snprintf(pos, sizeof pos, "%s", buf);
 					bin2DNA(header_checksum, buf);
-					strncpy(header_checksum, buf, 34);
+					snprintf(header_checksum, sizeof header_checksum, "%s", buf);
 					bin2DNA(data, buf);
-					strncpy(data, buf, 2049);
+					snprintf(data, sizeof data, "%s", buf);
 					bin2DNA(data_checksum, buf);
-					strncpy(data_checksum, buf, 34);
+					snprintf(data_checksum, sizeof data_checksum, "%s", buf);
 					bin2DNA(footer_version, buf);
-					strncpy(footer_version, buf, 65);
+					snprintf(footer_version, sizeof footer_version, "%s", buf);
 				}
 
 
@@ -554,7 +576,7 @@ static void convert_xml(char *source_file, char *output_file, int mode)
 
 static void usage(void)
 { fprintf(stderr,
-		  "Usage:  DNAIO -b|-d|-f|-c source-file output-file\n\n-b Converts from DNA XML to binary XML\n-d Converts from binary XML to DNA XML\n-f Converts from binary XML to DNA fasta\n-c Converts from DNA fasta to binary blocks\n");
+		  "Usage:  DNAIO -b|-d|-f|-c|-t source-file output-file\n\n-b Converts from DNA XML to binary XML\n-d Converts from binary XML to DNA XML\n-f Converts from binary XML to DNA fasta\n-c Converts from DNA fasta to packed binary blocks\n-t Converts from DNA fasta to binary blocks as '0' and '1' text\n");
 exit(1);
 }
 
@@ -571,7 +593,7 @@ int main ( int argc,  char **argv)
 	{ usage();
 	}
 
-	if (strcmp(argv[1],"-b")!=0 && strcmp(argv[1],"-d")!=0 && strcmp(argv[1],"-f")!=0 && strcmp(argv[1],"-c")!=0)
+	if (strcmp(argv[1],"-b")!=0 && strcmp(argv[1],"-d")!=0 && strcmp(argv[1],"-f")!=0 && strcmp(argv[1],"-c")!=0 && strcmp(argv[1],"-t")!=0)
 	{ usage();
 	}
 
@@ -583,10 +605,12 @@ int main ( int argc,  char **argv)
 		mode=3;
 	}else if (strcmp(argv[1],"-c")==0){
 		mode=4;
+	}else if (strcmp(argv[1],"-t")==0){
+		mode=5;
 	}
 
-	if (mode==4){
-		parse_DNA_blocks ( source_file, output_file);
+	if (mode==4 || mode==5){
+		parse_DNA_blocks ( source_file, output_file, mode==4);
 	}
 	else{
 		convert_xml(source_file, output_file, mode);
@@ -18,10 +18,11 @@
  * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
  * USE OR OTHER DEALINGS IN THE SOFTWARE.
  *  */
-int bin2dec(char *bin)   
+long bin2dec(char *bin)   
 {
-  int  b, k, m, n;
-  int  len, sum = 0;
+  long b, sum = 0;
+  int  k, m, n;
+  int  len;
 
   len = strlen(bin) - 1;
   for(k = 0; k <= len; k++) 
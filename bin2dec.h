@@ -18,5 +18,5 @@
  * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
  * USE OR OTHER DEALINGS IN THE SOFTWARE.
  *  */
-int bin2dec(char *);
+long bin2dec(char *);
 
@@ -0,0 +1,195 @@
+/* BITPACK.C - Routines to pack and unpack bits. */
+
+/* Copyright (c) 2014 by Allen Yu
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *  */
+
+/* Bits are packed and unpacked eight at a time, as a byte and a 64-bit 
+   word holding one bit in each of its bytes.  A byte is spread to a word 
+   by one multiply (by a constant with a 1 every nine bits, so the shifted 
+   copies of the byte don't overlap), and a word is gathered to a byte by 
+   another.  When compiled for a processor with the BMI2 instructions 
+   (eg, with -march=native), PDEP and PEXT are used instead.  The words are
+   stored to and loaded from memory as is, which puts the first bit in the 
+   right place only if bytes are little-endian, so otherwise bits are done 
+   one at a time. */
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+#include "bitpack.h"
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__==__ORDER_LITTLE_ENDIAN__
+#define Bitpack_words 1
+#else
+#define Bitpack_words 0
+#endif
+
+#define Ones 0x0101010101010101ULL	/* Low-order bit of every byte */
+#define Zeros 0x3030303030303030ULL	/* '0' in every byte */
+
+
+/* SPREAD THE BITS OF A BYTE TO A WORD.  The high-order bit goes to the 
+   low-order byte, which is the first in memory. */
+
+static inline uint64_t spread
+( unsigned x		/* Byte to spread */
+)
+{
+#ifdef __BMI2__
+  return __builtin_bswap64 (_pdep_u64 (x, Ones));
+#else
+  return ((x * 0x8040201008040201ULL) >> 7) & Ones;
+#endif
+}
+
+
+/* GATHER THE BITS OF A WORD TO A BYTE.  The reverse of spread, for a word
+   with only the low-order bits of its bytes set. */
+
+static inline unsigned gather
+( uint64_t w		/* Word to gather */
+)
+{
+#ifdef __BMI2__
+  return _pext_u64 (__builtin_bswap64 (w), Ones);
+#else
+  return (w * 0x8040201008040201ULL) >> 56;
+#endif
+}
+
+
+/* UNPACK BITS, AS 0 OR 1. */
+
+void bitpack_unpack
+( unsigned char *p,	/* Packed bits */
+  char *b,		/* Place to store bits */
+  int n			/* Number of bits */
+)
+{
+  uint64_t w;
+  int i;
+
+  i = 0;
+
+  if (Bitpack_words)
+  { for ( ; i+8<=n; i += 8)
+    { w = spread (p[i>>3]);
+      memcpy (b+i, &w, 8);
+    }
+  }
+
+  for ( ; i<n; i++)
+  { b[i] = (p[i>>3] >> (7-(i&7))) & 1;
+  }
+}
+
+
+/* UNPACK BITS, AS '0' OR '1' CHARACTERS. */
+
+void bitpack_unpack_text
+( unsigned char *p,	/* Packed bits */
+  char *b,		/* Place to store characters */
+  int n			/* Number of bits */
+)
+{
+  uint64_t w;
+  int i;
+
+  i = 0;
+
+  if (Bitpack_words)
+  { for ( ; i+8<=n; i += 8)
+    { w = spread (p[i>>3]) | Zeros;
+      memcpy (b+i, &w, 8);
+    }
+  }
+
+  for ( ; i<n; i++)
+  { b[i] = "01"[(p[i>>3] >> (7-(i&7))) & 1];
+  }
+}
+
+
+/* PACK BITS, GIVEN AS 0 OR 1. */
+
+int bitpack_pack
+( char *b,		/* Bits to pack */
+  unsigned char *p,	/* Place to store packed bits */
+  int n			/* Number of bits */
+)
+{
+  uint64_t w, bad;
+  int i;
+
+  bad = 0;
+  i = 0;
+
+  if (Bitpack_words)
+  { for ( ; i+8<=n; i += 8)
+    { memcpy (&w, b+i, 8);
+      bad |= w & ~Ones;
+      p[i>>3] = gather (w);
+    }
+  }
+
+  for ( ; i<n; i++)
+  { if ((i&7)==0) p[i>>3] = 0;
+    bad |= (unsigned char) b[i] & ~1;
+    p[i>>3] |= (b[i]&1) << (7-(i&7));
+  }
+
+  return bad ? -1 : 0;
+}
+
+
+/* PACK BITS, GIVEN AS '0' OR '1' CHARACTERS. */
+
+int bitpack_pack_text
+( char *b,		/* Characters to pack */
+  unsigned char *p,	/* Place to store packed bits */
+  int n			/* Number of bits */
+)
+{
+  uint64_t w, bad;
+  int i;
+
+  bad = 0;
+  i = 0;
+
+  if (Bitpack_words)
+  { for ( ; i+8<=n; i += 8)
+    { memcpy (&w, b+i, 8);
+      w ^= Zeros;
+      bad |= w & ~Ones;
+      p[i>>3] = gather (w);
+    }
+  }
+
+  for ( ; i<n; i++)
+  { if ((i&7)==0) p[i>>3] = 0;
+    bad |= ((unsigned char) b[i] ^ '0') & ~1;
+    p[i>>3] |= (b[i]&1) << (7-(i&7));
+  }
+
+  return bad ? -1 : 0;
+}
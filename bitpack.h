@@ -0,0 +1,32 @@
+/* BITPACK.H - Interface to routines that pack and unpack bits. */
+
+/* Copyright (c) 2014 by Allen Yu
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *  */
+
+/* Bits are unpacked into arrays of chars, one bit per char, as 0 or 1, or 
+   as '0' or '1' characters for the _text versions.  They are packed eight
+   to a byte, with the first bit in the high-order bit of the first byte.
+   If the number of bits isn't a multiple of eight, the unused low-order 
+   bits of the last byte are zero.  The pack routines return 0 if all the 
+   bits were valid, and -1 if one wasn't (what is stored is then garbage). */
+
+void bitpack_unpack (unsigned char *, char *, int);
+void bitpack_unpack_text (unsigned char *, char *, int);
+int  bitpack_pack (char *, unsigned char *, int);
+int  bitpack_pack_text (char *, unsigned char *, int);
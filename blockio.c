@@ -39,12 +39,59 @@
 #include <stdio.h>
 #include <string.h>
 #include <limits.h>
-#include <math.h>
+#include "intio.h"
+#include "bitpack.h"
 #include "blockio.h"
 #include "crc.h"
 #include "version.h"
 #include "int2bin.h"
 
+/* SPACE FOR BLOCKS.  Blocks are packed into pk_buf, and the characters for
+   blocks written as text are put in tx_buf, before being read or written
+   in one go.  The space is enlarged as needed, and is separate for each
+   thread. */
+
+static _Thread_local unsigned char *pk_buf;  /* Bytes of a packed block */
+static _Thread_local int pk_len;	     /* Space allocated for pk_buf */
+
+static _Thread_local char *tx_buf;	     /* Characters of a block */
+static _Thread_local int tx_len;	     /* Space allocated for tx_buf */
+
+static unsigned char *pk_space
+( int n			/* Number of bytes needed */
+)
+{
+  if (n>pk_len)
+  { free(pk_buf);
+    pk_buf = malloc(n);
+    if (pk_buf==0)
+    { fprintf(stderr,"Ran out of memory for packed block\n");
+      exit(1);
+    }
+    pk_len = n;
+  }
+
+  return pk_buf;
+}
+
+static char *tx_space
+( int n			/* Number of characters needed */
+)
+{
+  if (n>tx_len)
+  { free(tx_buf);
+    tx_buf = malloc(n);
+    if (tx_buf==0)
+    { fprintf(stderr,"Ran out of memory for block\n");
+      exit(1);
+    }
+    tx_len = n;
+  }
+
+  return tx_buf;
+}
+
+
 /* READ A BLOCK OF BITS.  The bits must be given as '0' or '1' characters,
    with whitespace allowed (but not required) between bits.  Returns 0 if
    a block is read successfully, and EOF if eof or an error occurs.  If
@@ -82,9 +129,11 @@ int blockio_read
   return 0;
 }
 
-/* READ A BLOCK OF BITS IN BINARY MODE. Returns 0 if a block is read successfully, 
-   and EOF if eof or an error occurs.  If EOF is returned, last position in block
-   will be recorded */
+/* READ A BLOCK OF BITS IN BINARY MODE.  The bytes of the block are read
+   in one go, and unpacked with the first bit of each in its high-order bit.
+   Returns 0 if a block is read successfully, and EOF if eof or an error 
+   occurs.  If EOF is returned, the bytes read before it are unpacked, and 
+   the position in the block after them is recorded. */
 
 int blockio_read_bin
 ( FILE *f,    /* File to read from */
@@ -93,33 +142,26 @@ int blockio_read_bin
   int *last_pos	/* Record the last position before EOF */
 )
 {
-  int i,j,n;
-  unsigned char* buffer;
-  buffer =(unsigned char*)malloc(sizeof(char)+1); 
+  unsigned char *p;
+  int n;
 
-  for (i = 0; i<l/CHAR_BIT; i++)
-  { 
-    n=fread(buffer, sizeof(char), 1, f);
-    if (feof( f )) 
-    { 
-      *last_pos=(i)*CHAR_BIT;
-      return EOF;
-    }
+  p = pk_space(l/CHAR_BIT);
 
-    for ( j = CHAR_BIT - 1; j >= 0; j-- )
-    {
-        b[i*CHAR_BIT+j] = (*buffer % 2) + '0'=='1';
-        *buffer /= 2;
-    }
-    
+  n = fread(p, 1, l/CHAR_BIT, f);
+  bitpack_unpack(p, b, n*CHAR_BIT);
+
+  if (n<l/CHAR_BIT) 
+  { *last_pos = n*CHAR_BIT;
+    return EOF;
   }
-  /*fprintf(stderr,"l:%d\nSize of block:%d\nblock:\n%s\n",l,sizeof(b),b);*/
+
   return 0;
 }
 
-/* WRITE A BLOCK OF BITS IN BINARY MODE. Returns 0 if a block is read successfully, 
-   and EOF if eof or an error occurs.  If EOF is returned, last position in block
-   will be recorded */
+/* WRITE A BLOCK OF BITS IN BINARY MODE.  The bits are given as '0' and '1'
+   characters, and written packed eight to a byte.  Returns 0 if the block
+   is written, and -1 if it has a character that isn't '0' or '1' (nothing 
+   is then written). */
 
 int blockio_write_bin
 ( FILE *f,    /* File to write */
@@ -127,30 +169,17 @@ int blockio_write_bin
   int l      /* Length of block in bits (multiple of 8)*/
 )
 {
-  int i,n,b, k, m;
-  int len;
-  unsigned char* buffer;
-  buffer =(unsigned char*)malloc(sizeof(char)+1); 
-
-  for(k = 0; k < strlen(bin); k+=sizeof(char)*8) 
-  {
-    *buffer=0;
-    for (i=0; i<sizeof(char)*8;i++){
-	    n = (bin[k+i] - '0'); // char to numeric value
-	    if ((n > 1) || (n < 0)) 
-	    {
-	      puts("\n\n ERROR! BINARY has only 1 and 0!\n");
-	      return (-1);
-	    }
-
-	    // 1 2 4 8 16 32 64 ... place-values, reversed here
-	    b = pow( 2, sizeof(char)*8-1-i );
-	    // sum it up
-	    *buffer = *buffer + n * b;
-    }
-    fwrite(buffer, sizeof(char), 1, f);
+  unsigned char *p;
+
+  p = pk_space(l/CHAR_BIT);
+
+  if (bitpack_pack_text(bin, p, l/CHAR_BIT*CHAR_BIT)!=0)
+  { fprintf(stderr,"Bad character in binary block (not '0' or '1')\n");
+    return -1;
   }
 
+  fwrite(p, 1, l/CHAR_BIT, f);
+
   return 0;
 }
 
@@ -164,26 +193,25 @@ void blockio_write
   int l        /* Length of block */
 )
 { 
-  int i,temp_byte;
+  unsigned char *p;
+  char *t;
   char binary_crc[80];
   crc_t crc;
 
-  temp_byte=0;
+  /* The checksum is of the whole bytes of the block, packed. */
+
+  p = pk_space((l+7)>>3);
+  if (bitpack_pack(b,p,l)!=0) abort();
 
   crc = crc_init();
-  fprintf(f, "\t<Data>");
+  crc = crc_update(crc, p, l>>3);
 
-  for (i = 0; i<l; i++)
-  { if (b[i]!=0 && b[i]!=1) abort();
-    putc("01"[b[i]],f);
-    temp_byte = (temp_byte << 1) | (b[i] != 0);
-    
-    if ((i+1)%8==0){
-	crc = crc_update(crc, (unsigned char *)&temp_byte, 1);      
-	temp_byte=0;
-    }
-  }
-  fprintf(f, "</Data>\n");
+  t = tx_space(l);
+  bitpack_unpack_text(p,t,l);
+
+  fputs("\t<Data>",f);
+  fwrite(t,1,l,f);
+  fputs("</Data>\n",f);
   
   crc = crc_finalize(crc);
   int2bin(crc,binary_crc);
@@ -196,12 +224,166 @@ void blockio_write_nocrc
   int l        /* Length of block */
 )
 { 
-  int i;
+  unsigned char *p;
+  char *t;
 
-  for (i = 0; i<l; i++)
-  { if (b[i]!=0 && b[i]!=1) abort();
-    putc("01"[b[i]],f);
+  p = pk_space((l+7)>>3);
+  if (bitpack_pack(b,p,l)!=0) abort();
+
+  t = tx_space(l+1);
+  bitpack_unpack_text(p,t,l);
+  t[l] = '\n';
+
+  fwrite(t,1,l+1,f);
+}
+
+
+/* PACKED BLOCK STREAMS.  Blocks of bits can also be stored packed, eight
+   to a byte, with the first bit of a block in the high-order bit of its
+   first byte, and each block starting in a new byte, with unused bits 
+   zero.  The blocks follow a header of 16 bytes, holding the magic bytes
+   in Blockio_magic, a version number byte, a flags byte (no flags are yet 
+   defined), two zero bytes, the block length, and the number of blocks, 
+   the last two as in intio.c.  The number of blocks is -1 if it wasn't 
+   known when the header was written, and the file couldn't be rewound to 
+   fill it in.
+
+   Programs reading blocks call blockio_read_header first, which finds out
+   whether the file holds packed blocks, or blocks of '0' and '1' characters
+   as read by blockio_read, so that both kinds are accepted. */
+
+/* READ THE HEADER OF A PACKED BLOCK STREAM, IF THERE IS ONE.  Returns 1 if
+   the file holds packed blocks, after reading the header, and 0 if it holds 
+   blocks of characters, having read nothing.  Blocks must have length l. */
+
+int blockio_read_header
+( FILE *f,    /* File to read from */
+  int l       /* Length of blocks expected */
+)
+{
+  char magic[4];
+  int c, v, n;
+
+  c = getc(f);
+
+  if (c!=(unsigned char)Blockio_magic[0])
+  { if (c!=EOF) ungetc(c,f);
+    return 0;
   }
 
-  putc('\n',f);
+  magic[0] = c;
+  if (fread(magic+1,1,3,f)!=3 || memcmp(magic,Blockio_magic,4)!=0)
+  { fprintf(stderr,"Bad header for packed blocks\n");
+    exit(1);
+  }
+
+  v = getc(f);
+  if (v!=Blockio_version)
+  { fprintf(stderr,"Packed blocks are version %d, not %d\n",v,Blockio_version);
+    exit(1);
+  }
+
+  if (getc(f)!=0 || getc(f)!=0 || getc(f)!=0)
+  { fprintf(stderr,"Packed blocks have unknown flags\n");
+    exit(1);
+  }
+
+  n = intio_read(f);
+  (void) intio_read(f);
+  if (feof(f) || ferror(f))
+  { fprintf(stderr,"Bad header for packed blocks\n");
+    exit(1);
+  }
+
+  if (n!=l)
+  { fprintf(stderr,
+      "Packed blocks have length %d, but blocks of length %d are needed\n",n,l);
+    exit(1);
+  }
+
+  return 1;
+}
+
+
+/* WRITE THE HEADER OF A PACKED BLOCK STREAM.  The number of blocks is 
+   written as -1, to be filled in later by blockio_write_count. */
+
+void blockio_write_header
+( FILE *f,    /* File to write to */
+  int l       /* Length of blocks */
+)
+{
+  fwrite(Blockio_magic,1,4,f);
+  putc(Blockio_version,f);
+  putc(0,f);
+  putc(0,f);
+  putc(0,f);
+  intio_write(f,l);
+  intio_write(f,-1);
+}
+
+
+/* FILL IN THE NUMBER OF BLOCKS IN A PACKED BLOCK STREAM.  Done only if the
+   file can be rewound to the header, which must be at its start, and if
+   the number fits in the four bytes for it (otherwise it stays -1, as for
+   a pipe).  Writing then continues at the end. */
+
+void blockio_write_count
+( FILE *f,    /* File written to */
+  long n      /* Number of blocks written */
+)
+{
+  if (n>INT_MAX || fseek(f,12,SEEK_SET)!=0)
+  { clearerr(f);
+    return;
+  }
+
+  intio_write(f,n);
+  fseek(f,0,SEEK_END);
+}
+
+
+/* READ A PACKED BLOCK.  Returns 0 if a block is read successfully, and EOF
+   if eof or an error occurs, with a warning if part of a block was read. */
+
+int blockio_read_packed
+( FILE *f,    /* File to read from */
+  char *b,    /* Place to store bits read */
+  int l       /* Length of block */
+)
+{
+  unsigned char *p;
+  int n;
+
+  p = pk_space((l+7)>>3);
+
+  n = fread(p,1,(l+7)>>3,f);
+  if (n<(l+7)>>3)
+  { if (n>0)
+    { fprintf(stderr,
+       "Warning: Short block (%d bytes) at end of input file ignored\n",n);
+    }
+    return EOF;
+  }
+
+  bitpack_unpack(p,b,l);
+
+  return 0;
+}
+
+
+/* WRITE A PACKED BLOCK. */
+
+void blockio_write_packed
+( FILE *f,     /* File to write to */
+  char *b,     /* Block of bits to write */
+  int l        /* Length of block */
+)
+{
+  unsigned char *p;
+
+  p = pk_space((l+7)>>3);
+  if (bitpack_pack(b,p,l)!=0) abort();
+
+  fwrite(p,1,(l+7)>>3,f);
 }
@@ -15,8 +15,17 @@
  * application.  All use of these programs is entirely at the user's own risk.
  */
 
+#define Blockio_magic "\211BLK"	/* First bytes of a packed block stream */
+#define Blockio_version 1	/* Version of the packed format written */
+
 int  blockio_read  (FILE *, char *, int);
 int  blockio_read_bin (FILE *, char *, int, int *);
 int  blockio_write_bin (FILE *, char *, int);
 void blockio_write (FILE *, char *, int);
 void blockio_write_nocrc (FILE *, char *, int);
+
+int  blockio_read_header  (FILE *, int);
+void blockio_write_header (FILE *, int);
+void blockio_write_count  (FILE *, long);
+int  blockio_read_packed  (FILE *, char *, int);
+void blockio_write_packed (FILE *, char *, int);
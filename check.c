@@ -15,12 +15,132 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <math.h>
 
+#include "alloc.h"
 #include "mod2sparse.h"
 #include "check.h"
 
 
+/* PACKED PARITY CHECKS.  After check_setup is called for a parity check
+   matrix, check packs the decoding into 64-bit words, and finds each parity
+   check by XORing the words holding its bits, masked to those bits, then
+   taking the parity of the result.  The bits of a row that lie in one word
+   share one mask.  Every row is given as many masks as the row needing the 
+   most, padded with masks of zero, so that the inner loop always runs the 
+   same number of times, and is predicted.  For any other matrix, check uses 
+   mod2sparse_mulvec as before. */
+
+static mod2sparse *ck_H;	/* Matrix the plan below is for */
+static int ck_M, ck_N;		/* Its dimensions */
+static int ck_words;		/* Number of words in a packed decoding */
+
+static int ck_len;		/* Number of masks for each row */
+static int *ck_word;		/* Index of word for each mask, ck_len per row */
+static uint64_t *ck_mask;	/* Bits of the row in that word */
+
+static _Thread_local uint64_t *ck_w;  /* Packed decoding */
+static _Thread_local int ck_w_words;  /* Number of words allocated for it */
+
+
+/* SET UP PACKED PARITY CHECKS.  Must be called before any threads use check,
+   since the plan is shared by them.  The matrix is frozen, if it isn't
+   already. */
+
+void check_setup
+( mod2sparse *H		/* Parity check matrix */
+)
+{
+  int i, j, k, n, w;
+
+  if (ck_H==H) return;
+
+  mod2sparse_freeze(H);
+
+  ck_M = mod2sparse_rows(H);
+  ck_N = mod2sparse_cols(H);
+  ck_words = (ck_N+63) >> 6;
+
+  /* Find the most distinct words in a row.  Entries in a row are in order
+     of column, so those in one word are together.  The matrix is frozen, so
+     the entries of a row are numbered consecutively. */
+
+  ck_len = 1;
+  for (i = 0; i<ck_M; i++)
+  { w = -1;
+    n = 0;
+    for (k = mod2sparse_row_start(H,i); k<mod2sparse_row_start(H,i+1); k++)
+    { j = mod2sparse_col(mod2sparse_entry(H,k));
+      if ((j>>6)!=w) 
+      { w = j>>6;
+        n += 1;
+      }
+    }
+    if (n>ck_len) ck_len = n;
+  }
+
+  free(ck_word); free(ck_mask);
+
+  ck_word = chk_alloc (ck_M*ck_len, sizeof *ck_word);
+  ck_mask = chk_alloc (ck_M*ck_len, sizeof *ck_mask);
+
+  for (i = 0; i<ck_M; i++)
+  { n = i*ck_len - 1;
+    w = -1;
+    for (k = mod2sparse_row_start(H,i); k<mod2sparse_row_start(H,i+1); k++)
+    { j = mod2sparse_col(mod2sparse_entry(H,k));
+      if ((j>>6)!=w) 
+      { w = j>>6;
+        n += 1;
+        ck_word[n] = w;
+      }
+      ck_mask[n] |= (uint64_t)1 << (j&63);
+    }
+  }
+
+  ck_H = H;
+}
+
+
+/* PACK A DECODING INTO WORDS.  Eight bits, each a char of 0 or 1, are 
+   gathered into one byte by a multiply, which moves the bit in byte k to 
+   bit 56+k with no carries. */
+
+static void check_pack
+( char *dblk,		/* Decoding, one bit per char */
+  uint64_t *w,		/* Place to store packed decoding */
+  int N			/* Number of bits */
+)
+{
+  unsigned char *p;
+  uint64_t x, b;
+  int j, k;
+
+  p = (unsigned char *) dblk;
+
+  for (k = 0; k<(N>>6); k++)
+  { x = 0;
+    for (j = 0; j<8; j++)
+    { b = (uint64_t)p[0]       | (uint64_t)p[1] << 8
+        | (uint64_t)p[2] << 16 | (uint64_t)p[3] << 24
+        | (uint64_t)p[4] << 32 | (uint64_t)p[5] << 40
+        | (uint64_t)p[6] << 48 | (uint64_t)p[7] << 56;
+      x |= ((b * 0x0102040810204080ULL) >> 56) << (8*j);
+      p += 8;
+    }
+    w[k] = x;
+  }
+
+  if (N&63)
+  { x = 0;
+    for (j = 0; j<(N&63); j++)
+    { x |= (uint64_t)(p[j]&1) << j;
+    }
+    w[k] = x;
+  }
+}
+
 
 /* COMPUTE PARITY CHECKS.  Returns the number of parity checks violated by
    dblk.  The results of all the parity checks are stored in pchk. */
@@ -31,15 +151,45 @@ int check
   char *pchk		/* Place to store parity checks */
 )
 {
-  int M, i, c;
+  uint64_t *mask, x;
+  int M, i, k, c;
+  int *word;
 
   M = mod2sparse_rows(H);
 
-  mod2sparse_mulvec (H, dblk, pchk);
+  if (H!=ck_H)
+  { 
+    mod2sparse_mulvec (H, dblk, pchk);
+
+    c = 0;
+    for (i = 0; i<M; i++) 
+    { c += pchk[i];
+    }
+
+    return c;
+  }
+
+  if (ck_w_words<ck_words)
+  { free(ck_w);
+    ck_w = chk_alloc (ck_words, sizeof *ck_w);
+    ck_w_words = ck_words;
+  }
+
+  check_pack (dblk, ck_w, ck_N);
+
+  word = ck_word;
+  mask = ck_mask;
 
   c = 0;
-  for (i = 0; i<M; i++) 
-  { c += pchk[i];
+  for (i = 0; i<M; i++)
+  { x = 0;
+    for (k = 0; k<ck_len; k++)
+    { x ^= ck_w[word[k]] & mask[k];
+    }
+    word += ck_len;
+    mask += ck_len;
+    pchk[i] = __builtin_parityll(x);
+    c += pchk[i];
   }
 
   return c;
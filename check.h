@@ -13,6 +13,7 @@
  * application.  All use of these programs is entirely at the user's own risk.
  */
 
+void check_setup (mod2sparse *);
 int check (mod2sparse *, char *, char *);
 
 double changed (double *, char *, int);
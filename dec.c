@@ -38,7 +38,10 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <math.h>
+#include <time.h>
+#include <pthread.h>
 
 #include "alloc.h"
 #include "mod2sparse.h"
@@ -47,6 +50,7 @@
 #include "rand.h"
 #include "rcode.h"
 #include "check.h"
+#include "decgraph.h"
 #include "dec.h"
 #include "enc.h"
 
@@ -56,11 +60,14 @@
 decoding_method dec_method;	/* Decoding method to use */
 
 int table;	/* Trace option, 2 for a table of decoding details */
-int block_no;	/* Number of current block, from zero */
+long block_no;	/* Number of current block, from zero */
 
 int max_iter;	/* Maximum number of iteratons of decoding to do */
 char *gen_file;	/* Generator file for Enum_block and Enum_bit */
 
+double ms_corr;	/* Scale factor for Minsum and Minsum_q8, or offset for 
+			   Minsum_offset */
+
 
 /* DECODE BY EXHAUSTIVE ENUMERATION.  Decodes by trying all possible source
    messages (and hence all possible codewords, unless the parity check matrix
@@ -78,11 +85,68 @@ char *gen_file;	/* Generator file for Enum_block and Enum_bit */
 
    The number of message bits should not be greater than 31 for this procedure.
    The setup procedure immediately below checks this, reads the generator file,
-   and outputs headers for the detailed trace file, if required.
+   and outputs headers for the detailed trace file, if required.  It also 
+   encodes each message with a single 1 bit, and saves these codewords, 
+   packed into 64-bit words.  Since the code is linear, the codeword for any
+   message is the exclusive-or of the saved codewords for its 1 bits.
+
+   Messages are tried in Gray code order, in which each message differs from
+   the one before in only one bit, so that the next codeword is found by 
+   exclusive-or of one saved codeword with the current one, and its log 
+   likelihood by adding or subtracting the log likelihood ratios of only the
+   bits that change.  These are rounded to integers, in units of 1/Enum_unit,
+   so that the sums are exact, and the log likelihood found for a codeword 
+   doesn't depend on which codewords were tried before it.  
+
+   When there are at least Enum_min_split message bits, the messages are 
+   divided into Enum_parts parts, which are tried by enum_threads threads, 
+   and the results for the parts are then combined in order.  The parts do
+   not depend on the number of threads, so neither does the result.  Ties 
+   for the most likely block go to the one tried first, in this order.
+
+   Space for all this is allocated by the setup procedure.  This procedure
+   must therefore not be called from more than one thread at once.
  */
 
+#define Enum_min_split 16	/* Fewest message bits for which the messages
+				   are divided into parts */
+#define Enum_parts 64		/* Number of parts messages are divided into */
+#define Enum_unit 16777216.0	/* Units in a log likelihood of one, when kept
+				   as an integer (sums for up to 700 million
+				   bits then fit in 64 bits) */
+#define Enum_max_llr 700.0	/* Largest magnitude allowed for a log 
+				   likelihood ratio */
+
+typedef struct
+{ unsigned first, last;	/* Range of positions in Gray code order to try */
+  uint64_t *cblk;	/* Current codeword, packed */
+  double *bpr;		/* Totals of likelihoods for codewords with each bit 1 */
+  double tpr;		/* Total of likelihoods for all codewords */
+  int64_t maxll;		/* Largest log likelihood found, less en_ll0 */
+  unsigned best;	/* Message with the largest log likelihood */
+} enum_part;
+
+static int en_words;		/* Number of words in a packed codeword */
+static uint64_t *en_gen;	/* Codeword for each message bit, packed */
+static int64_t *en_llr;		/* Log likelihood ratios (of 1 over 0), in
+				   units of 1/Enum_unit */
+static double en_ll0;		/* Log likelihood of the all-zero codeword */
+static double en_llmax;		/* Bound on log likelihood of any codeword */
+static int en_marg;		/* Are marginal probabilities needed? */
+
+static int en_n_parts;		/* Number of parts messages are divided into */
+static int en_n_threads;	/* Number of threads trying the parts */
+static enum_part *en_parts;	/* Data for each part */
+
+int enum_threads;	/* Number of threads for Enum_block and Enum_bit */
+
 void enum_decode_setup(void)
 {
+  mod2dense *u, *v;
+  char sblk[31];
+  char *cblk;
+  int i, j, p;
+
   read_gen(gen_file,0,0);
 
   if (N-M>31)
@@ -92,36 +156,20 @@ void enum_decode_setup(void)
     exit(1);  
   }
 
-  if (table==2)
-  { printf("  block   decoding  likelihood\n");
-  }
-}
-
-unsigned enum_decode
-( double *lratio,	/* Likelihood ratios for bits */
-  char *dblk, 		/* Place to stored decoded message */
-  double *bitpr,	/* Place to store marginal bit probabilities */
-  int max_block		/* Maximize probability of whole block being correct? */
-)
-{
-  mod2dense *u, *v;
-  double lk, maxlk, tpr;
-  double *bpr, *lk0, *lk1;
-  char sblk[31];
-  char *cblk;
-  unsigned d;
-  int i, j;
+  /* Find codewords for messages with a single 1 bit. */
 
-  if (N-M>31) abort();
+  en_words = (N+63) / 64;
+  en_gen = chk_alloc ((N-M)*en_words, sizeof *en_gen);
 
-  /* Allocate needed space. */
+  cblk = chk_alloc (N, sizeof *cblk);
 
-  bpr = bitpr;
-  if (bpr==0 && max_block==0)
-  { bpr = chk_alloc (N, sizeof *bpr);
+  if (type=='s')
+  { sparse_encode_setup();
   }
 
-  cblk = chk_alloc (N, sizeof *cblk);
+  if (type=='r')
+  { ru_encode_setup();
+  }
 
   if (type=='d')
   { u = mod2dense_allocate(N-M,1);
@@ -133,36 +181,12 @@ unsigned enum_decode
     v = mod2dense_allocate(M,1);
   }
 
-  lk0 = chk_alloc (N, sizeof *lk0);
-  lk1 = chk_alloc (N, sizeof *lk1);
-
-  /* Pre-compute likelihoods for bits. */
-
-  for (j = 0; j<N; j++)
-  { lk0[j] = 1/(1+lratio[j]);
-    lk1[j] = 1 - lk0[j];
-  }
-
-  /* Initialize marginal bit probabilities. */
-
-  if (bpr)
-  { for (j = 0; j<N; j++) bpr[j] = 0.0;
-  }
-
-  /* Exhaustively try all possible decoded messages. */
-
-  tpr = 0.0;
-
-  for (d = 0; d<=(1<<(N-M))-1; d++)
-  {
-    /* Unpack message into source block. */
-
-    for (i = N-M-1; i>=0; i--)
-    { sblk[i] = (d>>i)&1;
+  for (i = 0; i<N-M; i++)
+  { 
+    for (j = 0; j<N-M; j++) 
+    { sblk[j] = j==i;
     }
 
-    /* Find full codeword for this message. */
-
     switch (type)
     { case 's':
       { sparse_encode (sblk, cblk);
@@ -176,67 +200,328 @@ unsigned enum_decode
       { mixed_encode (sblk, cblk, u, v);
         break;
       }
+      case 'r':
+      { ru_encode (sblk, cblk);
+        break;
+      }
     }
 
-    /* Compute likelihood for this decoding. */
-
-    lk = 1;
     for (j = 0; j<N; j++)
-    { lk *= cblk[j]==0 ? lk0[j] : lk1[j];
+    { if (cblk[j]) 
+      { en_gen[i*en_words+j/64] |= (uint64_t)1 << (j%64);
+      }
     }
+  }
 
-    /* Update maximum likelihood decoding. */
+  if (type=='d' || type=='m')
+  { mod2dense_free(u);
+    mod2dense_free(v);
+  }
 
-    if (max_block)
-    { if (d==0 || lk>maxlk)
-      { for (j = 0; j<N; j++)
-        { dblk[j] = cblk[j];
+  free(cblk);
+
+  /* Allocate space for each part of the enumeration. */
+
+  en_n_parts = N-M>=Enum_min_split ? Enum_parts : 1;
+  en_n_threads = enum_threads<1 ? 1 
+               : enum_threads>en_n_parts ? en_n_parts : enum_threads;
+  en_parts = chk_alloc (en_n_parts, sizeof *en_parts);
+
+  for (p = 0; p<en_n_parts; p++)
+  { en_parts[p].cblk = chk_alloc (en_words, sizeof *en_parts[p].cblk);
+    en_parts[p].bpr = chk_alloc (N, sizeof *en_parts[p].bpr);
+  }
+
+  en_llr = chk_alloc (N, sizeof *en_llr);
+
+  if (table==2)
+  { printf("  block   decoding  likelihood\n");
+  }
+}
+
+/* Try the messages in one part of the Gray code order. */
+
+static void enum_try
+( enum_part *p		/* Part to try */
+)
+{
+  uint64_t *g, *cblk;
+  uint64_t x;
+  unsigned d, msg;
+  int64_t ll;
+  double lk;
+  int i, j, w, b;
+
+  cblk = p->cblk;
+
+  /* Find the first codeword and its log likelihood from scratch. */
+
+  msg = p->first ^ (p->first>>1);
+
+  for (w = 0; w<en_words; w++) 
+  { cblk[w] = 0;
+  }
+  for (i = 0; i<N-M; i++)
+  { if ((msg>>i)&1)
+    { g = en_gen + i*en_words;
+      for (w = 0; w<en_words; w++) cblk[w] ^= g[w];
+    }
+  }
+
+  ll = 0;
+  for (j = 0; j<N; j++)
+  { if ((cblk[j/64]>>(j%64))&1) ll += en_llr[j];
+  }
+
+  p->tpr = 0;
+  for (j = 0; j<N; j++) 
+  { p->bpr[j] = 0;
+  }
+
+  for (d = p->first; ; )
+  { 
+    /* Update the most likely block, and totals for bit probabilities. 
+       Likelihoods are scaled by exp(-en_llmax), so they can't overflow, 
+       which cancels when the totals are normalized. */
+
+    if (d==p->first || ll>p->maxll)
+    { p->maxll = ll;
+      p->best = msg;
+    }
+
+    if (en_marg)
+    { lk = exp(en_ll0-en_llmax+ll/Enum_unit);
+      for (w = 0; w<en_words; w++)
+      { for (x = cblk[w]; x!=0; x &= x-1)
+        { p->bpr[w*64+__builtin_ctzll(x)] += lk;
         }
-        maxlk = lk;
       }
+      p->tpr += lk;
     }
 
-    /* Update bit probabilities. */
- 
-    if (bpr)
-    { for (j = 0; j<N; j++) 
-      { if (cblk[j]==1) 
-        { bpr[j] += lk;
-        }
+    if (table==2)
+    { printf("%7ld %10x  %10.4e\n",block_no,msg,exp(en_ll0+ll/Enum_unit));
+    }
+
+    /* Go on to the next message, which differs in the bit that is the 
+       lowest 1 bit in the next position. */
+
+    d += 1;
+    if (d==p->last) break;
+
+    i = __builtin_ctz(d);
+    msg ^= 1u<<i;
+
+    g = en_gen + i*en_words;
+    for (w = 0; w<en_words; w++)
+    { x = g[w];
+      cblk[w] ^= x;
+      for ( ; x!=0; x &= x-1)
+      { b = __builtin_ctzll(x);
+        ll += (cblk[w]>>b)&1 ? en_llr[w*64+b] : -en_llr[w*64+b];
       }
-      tpr += lk;
     }
+  }
+}
 
-    /* Output data to trace file. */
+/* Try the parts given to one thread, which are every en_n_threads'th part,
+   starting with the one passed. */
 
-    if (table==2)
-    { printf("%7d %10x  %10.4e\n",block_no,d,lk);
+static void *enum_run
+( void *arg		/* First part to try */
+)
+{
+  enum_part *p;
+
+  for (p = arg; p<en_parts+en_n_parts; p += en_n_threads)
+  { enum_try(p);
+  }
+
+  return 0;
+}
+
+unsigned enum_decode
+( double *lratio,	/* Likelihood ratios for bits */
+  char *dblk, 		/* Place to stored decoded message */
+  double *bitpr,	/* Place to store marginal bit probabilities */
+  int max_block		/* Maximize probability of whole block being correct? */
+)
+{
+  pthread_t *threads;
+  enum_part *p;
+  unsigned n_msgs;
+  uint64_t *g, *cblk;
+  double l, tpr;
+  int64_t maxll;
+  unsigned best;
+  int i, j, w, k;
+
+  if (N-M>31) abort();
+
+  /* Find log likelihood ratios for bits, and the log likelihood of the 
+     all-zero codeword, and a bound on the log likelihood of any codeword. */
+
+  en_ll0 = 0;
+  en_llmax = 0;
+
+  for (j = 0; j<N; j++)
+  { l = log(lratio[j]);
+    if (!(l<=Enum_max_llr)) l = Enum_max_llr;   /* Also catches a NaN */
+    if (l<-Enum_max_llr) l = -Enum_max_llr;
+    en_llr[j] = llround (l*Enum_unit);
+    en_llmax -= log1p(exp(-fabs(l)));
+    en_ll0 -= (l>0 ? l : 0) + log1p(exp(-fabs(l)));
+  }
+
+  en_marg = bitpr!=0 || max_block==0;
+
+  /* Exhaustively try all possible decoded messages, in parts. */
+
+  n_msgs = (unsigned)1 << (N-M);
+
+  for (k = 0; k<en_n_parts; k++)
+  { en_parts[k].first = (unsigned) ((double)n_msgs * k / en_n_parts);
+    en_parts[k].last = (unsigned) ((double)n_msgs * (k+1) / en_n_parts);
+  }
+
+  if (en_n_threads==1)
+  { enum_run(&en_parts[0]);
+  }
+  else
+  { threads = chk_alloc (en_n_threads, sizeof *threads);
+    for (k = 0; k<en_n_threads; k++)
+    { if (pthread_create(&threads[k],NULL,enum_run,&en_parts[k])!=0)
+      { fprintf(stderr,"Can't create decoding thread\n");
+        exit(1);
+      }
+    }
+    for (k = 0; k<en_n_threads; k++)
+    { pthread_join(threads[k],NULL);
+    }
+    free(threads);
+  }
+
+  /* Combine the results for the parts in order, so that a tie goes to the
+     earlier part, putting the totals for bit probabilities in the first. */
+
+  p = &en_parts[0];
+  maxll = p->maxll;
+  best = p->best;
+  tpr = p->tpr;
+
+  for (k = 1; k<en_n_parts; k++)
+  { if (en_parts[k].maxll>maxll)
+    { maxll = en_parts[k].maxll;
+      best = en_parts[k].best;
+    }
+    if (en_marg)
+    { for (j = 0; j<N; j++) p->bpr[j] += en_parts[k].bpr[j];
+      tpr += en_parts[k].tpr;
     }
   }
 
   /* Normalize bit probabilities. */
 
-  if (bpr)
-  { for (j = 0; j<N; j++) bpr[j] /= tpr;
+  if (en_marg)
+  { for (j = 0; j<N; j++) p->bpr[j] /= tpr;
+    if (bitpr)
+    { for (j = 0; j<N; j++) bitpr[j] = p->bpr[j];
+    }
   }
 
-  /* Decoding to maximize bit-by-bit success, if that's what's wanted. 
-     In case of a tie, decode to a 1. */
+  /* Decoding to maximize probability of the whole block, found from the
+     most likely message, or to maximize bit-by-bit success.  In case of a 
+     tie in the latter, decode to a 1. */
 
-  if (!max_block)
+  if (max_block)
+  { cblk = p->cblk;
+    for (w = 0; w<en_words; w++) 
+    { cblk[w] = 0;
+    }
+    for (i = 0; i<N-M; i++)
+    { if ((best>>i)&1)
+      { g = en_gen + i*en_words;
+        for (w = 0; w<en_words; w++) cblk[w] ^= g[w];
+      }
+    }
+    for (j = 0; j<N; j++)
+    { dblk[j] = (cblk[j/64]>>(j%64))&1;
+    }
+  }
+  else
   { for (j = 0; j<N; j++) 
-    { dblk[j] = bpr[j]>=0.5;
+    { dblk[j] = p->bpr[j]>=0.5;
     }
   }
 
-  /* Free space. */
+  return 1<<(N-M);
+}
 
-  if (bpr!=0 && bpr!=bitpr) free(bpr);
-  free(cblk);
-  free(lk0);
-  free(lk1);
 
-  return 1<<(N-M);
+/* DECODING GRAPH AND MESSAGES.  The probability propagation and min-sum 
+   methods do not work on the parity check matrix directly, but on a decoding
+   graph compiled from it when the method is set up, with the messages for 
+   each edge kept in separate arrays (see decgraph.h). 
+
+   The graph is shared, but the messages and other working space for these
+   methods are local to a thread, so that blocks can be decoded by several
+   threads at once.  This space is allocated when a thread first decodes a
+   block. 
+
+   The parity checks of the current decoding are found with the check 
+   procedure only at the start of a block.  After that, an iteration changes
+   only the checks containing the bits whose decoding changes, which it 
+   flips with dg_flip, keeping track of the number of checks that fail.  
+   Since few bits change once decoding is under way, this costs much less 
+   than finding all the checks again. */
+
+static decgraph *dg;		/* Graph compiled from the parity check matrix */
+
+static _Thread_local double *dg_pr;	/* Messages from bits to checks */
+static _Thread_local double *dg_lr;	/* Messages from checks to bits */
+
+static void dg_setup (void)
+{
+  if (dg) return;
+
+  dg = decgraph_build(H);
+}
+
+static void dg_alloc (void)
+{
+  if (dg_pr) return;
+
+  dg_pr = chk_alloc (decgraph_edges(dg)+1, sizeof *dg_pr);
+  dg_lr = chk_alloc (decgraph_edges(dg)+1, sizeof *dg_lr);
+}
+
+/* Flip bit j of the decoding, and the parity checks that it is in, returning
+   the change in the number of checks that fail. */
+
+static int dg_flip
+( decgraph *g,		/* Decoding graph */
+  int j,		/* Bit to flip */
+  char *dblk,		/* Current decoding */
+  char *pchk		/* Parity checks for the current decoding */
+)
+{
+  int *col_edge, *edge_row;
+  int c, i, k, kl;
+
+  col_edge = g->col_edge;
+  edge_row = g->edge_row;
+
+  dblk[j] ^= 1;
+
+  c = 0;
+  kl = g->col_start[j+1];
+  for (k = g->col_start[j]; k<kl; k++)
+  { i = edge_row[col_edge[k]];
+    pchk[i] ^= 1;
+    c += pchk[i] ? 1 : -1;
+  }
+
+  return c;
 }
 
 
@@ -255,12 +540,16 @@ unsigned enum_decode
    will be zero if the codeword is valid).  The final probabilities for each 
    bit being a 1 are stored in bprb.
 
-   The setup procedure immediately below outputs headers for the detailed trace
+   The setup procedure immediately below compiles the decoding graph for the
+   parity check matrix in the H global variable, which must be the matrix
+   later passed to prprp_decode, and outputs headers for the detailed trace 
    file, if required.
 */
 
 void prprp_decode_setup (void)
 {
+  dg_setup();
+
   if (table==2)
   { printf(
      "  block  iter  changed  perrs    loglik   Eperrs   Eloglik  entropy\n");
@@ -279,19 +568,21 @@ unsigned prprp_decode
 
   N = mod2sparse_cols(H);
 
+  dg_alloc();
+
   /* Initialize probability and likelihood ratios, and find initial guess. */
 
-  initprp(H,lratio,dblk,bprb);
+  initprp(dg,lratio,dblk,bprb);
 
   /* Do up to abs(max_iter) iterations of probability propagation, stopping
      early if a codeword is found, unless max_iter is negative. */
 
+  c = check(H,dblk,pchk);
+
   for (n = 0; ; n++)
   { 
-    c = check(H,dblk,pchk);
-
     if (table==2)
-    { printf("%7d %5d %8.1f %6d %+9.2f %8.1f %+9.2f  %7.1f\n",
+    { printf("%7ld %5d %8.1f %6d %+9.2f %8.1f %+9.2f  %7.1f\n",
        block_no, n, changed(lratio,dblk,N), c, loglikelihood(lratio,dblk,N), 
        expected_parity_errors(H,bprb), expected_loglikelihood(lratio,bprb,N),
        entropy(bprb,N));
@@ -301,7 +592,7 @@ unsigned prprp_decode
     { break; 
     }
 
-    iterprp(H,lratio,dblk,bprb);
+    c += iterprp(dg,lratio,dblk,pchk,bprb);
   }
 
   return n;
@@ -312,24 +603,24 @@ unsigned prprp_decode
    and guess at decoding. */
 
 void initprp
-( mod2sparse *H,	/* Parity check matrix */
+( decgraph *g,		/* Decoding graph */
   double *lratio,	/* Likelihood ratios for bits */
   char *dblk,		/* Place to store decoding */
   double *bprb		/* Place to store bit probabilities, 0 if not wanted */
 )
 { 
-  mod2entry *e;
+  int *col_edge;
   int N;
-  int j;
+  int j, k, kl;
 
-  N = mod2sparse_cols(H);
+  N = decgraph_cols(g);
+  col_edge = g->col_edge;
 
   for (j = 0; j<N; j++)
-  { for (e = mod2sparse_first_in_col(H,j);
-         !mod2sparse_at_end(e);
-         e = mod2sparse_next_in_col(e))
-    { e->pr = lratio[j];
-      e->lr = 1;
+  { kl = g->col_start[j+1];
+    for (k = g->col_start[j]; k<kl; k++)
+    { dg_pr[col_edge[k]] = lratio[j];
+      dg_lr[col_edge[k]] = 1;
     }
     if (bprb) bprb[j] = 1 - 1/(1+lratio[j]);
     dblk[j] = lratio[j]>=1;
@@ -337,68 +628,1681 @@ void initprp
 }
 
 
-/* DO ONE ITERATION OF PROBABILITY PROPAGATION. */
+/* DO ONE ITERATION OF PROBABILITY PROPAGATION.  Updates the decoding and
+   its parity checks, and returns the change in the number that fail. */
 
-void iterprp
-( mod2sparse *H,	/* Parity check matrix */
+int iterprp
+( decgraph *g,		/* Decoding graph */
   double *lratio,	/* Likelihood ratios for bits */
-  char *dblk,		/* Place to store decoding */
+  char *dblk,		/* Current decoding, updated */
+  char *pchk,		/* Parity checks for the decoding, updated */
   double *bprb		/* Place to store bit probabilities, 0 if not wanted */
 )
 {
   double pr, dl, t;
-  mod2entry *e;
+  double *prs, *lrs;
+  int *col_edge;
   int N, M;
-  int i, j;
+  int i, j, k, kf, kl, c;
 
-  M = mod2sparse_rows(H);
-  N = mod2sparse_cols(H);
+  M = decgraph_rows(g);
+  N = decgraph_cols(g);
+
+  prs = dg_pr;
+  lrs = dg_lr;
+  col_edge = g->col_edge;
 
   /* Recompute likelihood ratios. */
 
   for (i = 0; i<M; i++)
-  { dl = 1;
-    for (e = mod2sparse_first_in_row(H,i);
-         !mod2sparse_at_end(e);
-         e = mod2sparse_next_in_row(e))
-    { e->lr = dl;
-      dl *= 2/(1+e->pr) - 1;
+  { kf = g->row_start[i];
+    kl = g->row_start[i+1];
+    dl = 1;
+    for (k = kf; k<kl; k++)
+    { lrs[k] = dl;
+      dl *= 2/(1+prs[k]) - 1;
     }
     dl = 1;
-    for (e = mod2sparse_last_in_row(H,i);
-         !mod2sparse_at_end(e);
-         e = mod2sparse_prev_in_row(e))
-    { t = e->lr * dl;
-      e->lr = (1-t)/(1+t);
-      dl *= 2/(1+e->pr) - 1;
+    for (k = kl-1; k>=kf; k--)
+    { t = lrs[k] * dl;
+      lrs[k] = (1-t)/(1+t);
+      dl *= 2/(1+prs[k]) - 1;
     }
   }
 
   /* Recompute probability ratios.  Also find the next guess based on the
      individually most likely values. */
 
+  c = 0;
+
   for (j = 0; j<N; j++)
-  { pr = lratio[j];
-    for (e = mod2sparse_first_in_col(H,j);
-         !mod2sparse_at_end(e);
-         e = mod2sparse_next_in_col(e))
-    { e->pr = pr;
-      pr *= e->lr;
+  { kf = g->col_start[j];
+    kl = g->col_start[j+1];
+    pr = lratio[j];
+    for (k = kf; k<kl; k++)
+    { prs[col_edge[k]] = pr;
+      pr *= lrs[col_edge[k]];
     }
     if (isnan(pr))
     { pr = 1;
     }
     if (bprb) bprb[j] = 1 - 1/(1+pr);
-    dblk[j] = pr>=1;
+    if ((pr>=1)!=dblk[j]) c += dg_flip(g,j,dblk,pchk);
     pr = 1;
-    for (e = mod2sparse_last_in_col(H,j);
-         !mod2sparse_at_end(e);
-         e = mod2sparse_prev_in_col(e))
-    { e->pr *= pr;
-      if (isnan(e->pr)) 
-      { e->pr = 1;
+    for (k = kl-1; k>=kf; k--)
+    { prs[col_edge[k]] *= pr;
+      if (isnan(prs[col_edge[k]])) 
+      { prs[col_edge[k]] = 1;
       }
-      pr *= e->lr;
+      pr *= lrs[col_edge[k]];
+    }
+  }
+
+  return c;
+}
+
+
+/* DECODE USING MIN-SUM MESSAGE PASSING.  An approximation to probability
+   propagation that passes log likelihood ratios (log of P(0)/P(1), so that
+   a negative value favours a 1) rather than probability ratios.  At a check, 
+   the message sent to a bit has the sign of the product of the other 
+   incoming messages and a magnitude equal to the smallest of their 
+   magnitudes, which is then corrected for the overestimate this produces, 
+   either by multiplying by ms_corr (Minsum) or by subtracting ms_corr, but 
+   not going below zero (Minsum_offset).  The check computation is thus done 
+   by comparisons rather than by divisions, and no message can become a NaN.
+
+   Iterations stop as described for prprp_decode, and the decoding, parity
+   checks and bit probabilities are returned in the same way.  Bit 
+   probabilities are found only after the last iteration, except when 
+   a detailed trace is being produced.
+
+   The messages are kept in the same arrays as for probability propagation,
+   with those from bits to checks in dg_pr, and those from checks to bits in 
+   dg_lr.  Space is also needed for the log likelihood ratios from the 
+   channel and for the posterior log likelihood ratios of each bit, which 
+   are kept between iterations.  The setup procedure immediately below 
+   compiles the decoding graph (as for prprp_decode_setup), and outputs 
+   headers for the detailed trace file, if required.
+*/
+
+#define Ms_max_llr 1000.0	/* Largest magnitude allowed for a log 
+				   likelihood ratio from the channel */
+
+static _Thread_local double *ms_llr;	/* Log likelihood ratios from the 
+					   channel */
+static _Thread_local double *ms_post;	/* Posterior log likelihood ratios */
+
+void minsum_decode_setup (void)
+{
+  dg_setup();
+
+  if (table==2)
+  { printf(
+     "  block  iter  changed  perrs    loglik   Eperrs   Eloglik  entropy\n");
+  }
+}
+
+/* Find bit probabilities from the posterior log likelihood ratios. */
+
+static void ms_bitpr
+( int N,		/* Number of bits */
+  double *bprb		/* Place to store bit probabilities */
+)
+{
+  int j;
+
+  for (j = 0; j<N; j++)
+  { bprb[j] = 1/(1+exp(ms_post[j]));
+  }
+}
+
+unsigned minsum_decode
+( mod2sparse *H,	/* Parity check matrix */
+  double *lratio,	/* Likelihood ratios for bits */
+  char *dblk,		/* Place to store decoding */
+  char *pchk,		/* Place to store parity checks */
+  double *bprb		/* Place to store bit probabilities, 0 if not wanted */
+)
+{ 
+  int N, n, c;
+
+  N = mod2sparse_cols(H);
+
+  dg_alloc();
+
+  if (!ms_llr)
+  { ms_llr  = chk_alloc (N, sizeof *ms_llr);
+    ms_post = chk_alloc (N, sizeof *ms_post);
+  }
+
+  /* Initialize messages, and find initial guess. */
+
+  initms(dg,lratio,dblk);
+
+  /* Do up to abs(max_iter) iterations, stopping early if a codeword is 
+     found, unless max_iter is negative. */
+
+  c = check(H,dblk,pchk);
+
+  for (n = 0; ; n++)
+  { 
+    if (table==2 && bprb)
+    { ms_bitpr(N,bprb);
+      printf("%7ld %5d %8.1f %6d %+9.2f %8.1f %+9.2f  %7.1f\n",
+       block_no, n, changed(lratio,dblk,N), c, loglikelihood(lratio,dblk,N), 
+       expected_parity_errors(H,bprb), expected_loglikelihood(lratio,bprb,N),
+       entropy(bprb,N));
+    }
+   
+    if (n==max_iter || n==-max_iter || (max_iter>0 && c==0))
+    { break; 
+    }
+
+    c += iterms(dg,dblk,pchk);
+  }
+
+  if (bprb) ms_bitpr(N,bprb);
+
+  return n;
+}
+
+
+/* INITIALIZE MIN-SUM DECODING.  Stores the log likelihood ratios from the
+   channel as the initial messages from bits to checks, and finds the initial
+   guess at decoding. */
+
+void initms
+( decgraph *g,		/* Decoding graph */
+  double *lratio,	/* Likelihood ratios for bits */
+  char *dblk		/* Place to store decoding */
+)
+{ 
+  double l;
+  int *col_edge;
+  int N;
+  int j, k, kl;
+
+  N = decgraph_cols(g);
+  col_edge = g->col_edge;
+
+  for (j = 0; j<N; j++)
+  { l = -log(lratio[j]);
+    if (!(l<=Ms_max_llr)) l = Ms_max_llr;   /* Also catches a NaN */
+    if (l<-Ms_max_llr) l = -Ms_max_llr;
+    ms_llr[j] = l;
+    ms_post[j] = l;
+    kl = g->col_start[j+1];
+    for (k = g->col_start[j]; k<kl; k++)
+    { dg_pr[col_edge[k]] = l;
+      dg_lr[col_edge[k]] = 0;
     }
+    dblk[j] = l<=0;
   }
 }
+
+
+/* DO ONE ITERATION OF MIN-SUM DECODING.  Updates the decoding and its 
+   parity checks, and returns the change in the number that fail. */
+
+int iterms
+( decgraph *g,		/* Decoding graph */
+  char *dblk,		/* Current decoding, updated */
+  char *pchk		/* Parity checks for the decoding, updated */
+)
+{
+  double a, min1, min2, t;
+  double *prs, *lrs;
+  int *col_edge;
+  int N, M;
+  int i, j, k, kf, kl, kmin, s, c;
+
+  M = decgraph_rows(g);
+  N = decgraph_cols(g);
+
+  prs = dg_pr;
+  lrs = dg_lr;
+  col_edge = g->col_edge;
+
+  /* Recompute messages from checks, using the two smallest magnitudes of 
+     the incoming messages and the parity of their signs. */
+
+  for (i = 0; i<M; i++)
+  { kf = g->row_start[i];
+    kl = g->row_start[i+1];
+    min1 = min2 = Ms_max_llr;
+    kmin = -1;
+    s = 0;
+    for (k = kf; k<kl; k++)
+    { a = prs[k];
+      s ^= signbit(a)!=0;
+      a = fabs(a);
+      t = a>min1 ? a : min1;	/* Written as selects rather than branches, */
+      min2 = t<min2 ? t : min2;	/*   since which way the comparisons go is  */
+      kmin = a<min1 ? k : kmin;	/*   hard to predict                        */
+      min1 = a<min1 ? a : min1;
+    }
+    if (dec_method==Minsum_offset)
+    { min1 = min1>ms_corr ? min1-ms_corr : 0;
+      min2 = min2>ms_corr ? min2-ms_corr : 0;
+    }
+    else
+    { min1 *= ms_corr;
+      min2 *= ms_corr;
+    }
+    if (s)
+    { min1 = -min1;
+      min2 = -min2;
+    }
+    for (k = kf; k<kl; k++)
+    { lrs[k] = copysign(1.0,prs[k]) * min1;
+    }
+    if (kmin>=0)
+    { lrs[kmin] = copysign(1.0,prs[kmin]) * min2;
+    }
+  }
+
+  /* Recompute messages from bits, which exclude the message from the check
+     they are sent to.  Also find the next guess based on the signs of the
+     posterior log likelihood ratios. */
+
+  c = 0;
+
+  for (j = 0; j<N; j++)
+  { kf = g->col_start[j];
+    kl = g->col_start[j+1];
+    t = ms_llr[j];
+    for (k = kf; k<kl; k++)
+    { t += lrs[col_edge[k]];
+    }
+    ms_post[j] = t;
+    if ((t<=0)!=dblk[j]) c += dg_flip(g,j,dblk,pchk);
+    for (k = kf; k<kl; k++)
+    { prs[col_edge[k]] = t - lrs[col_edge[k]];
+    }
+  }
+
+  return c;
+}
+
+
+/* DECODE USING PROBABILITY PROPAGATION WITH A LAYERED SCHEDULE.  Computes
+   the same messages from checks to bits as probability propagation, but 
+   rather than recomputing all of them and then all messages from bits, the
+   checks are processed one at a time, and the posterior probability ratio
+   of each bit in a check is updated as soon as the check has been processed.
+   Later checks in the same iteration therefore see the new information, 
+   which typically lets decoding converge in about half as many iterations.
+
+   The message from a bit to a check is found as needed by dividing the
+   posterior ratio for the bit by the check's previous message to it.  So 
+   that this division cannot produce a NaN, messages from checks are kept 
+   away from zero and infinity by limiting the magnitude of the product in 
+   iterprp's formula to Ly_max_t, and posterior ratios are limited to the 
+   range 1/Ly_max_ratio to Ly_max_ratio.
+
+   Iterations stop as described for prprp_decode, and the decoding, parity
+   checks and bit probabilities are returned in the same way.  Bit 
+   probabilities are found only after the last iteration, except when 
+   a detailed trace is being produced.
+
+   Space is needed for the posterior ratios and for the computations on one
+   row, the maximum size of which is found by the setup procedure immediately
+   below.  It also compiles the decoding graph (as for prprp_decode_setup), 
+   and outputs headers for the detailed trace file, if required.
+*/
+
+#define Ly_max_t (1-1e-12)	/* Limit on magnitude of product of terms */
+#define Ly_max_ratio 1e100	/* Limit on posterior probability ratios */
+
+static int ly_maxw;		/* Maximum number of bits in a check */
+
+static _Thread_local double *ly_post;	/* Posterior probability ratios */
+static _Thread_local double *ly_v;	/* Messages from bits to the current 
+					   check */
+static _Thread_local double *ly_d;	/* Terms for these in the check's 
+					   product */
+
+void layered_decode_setup (void)
+{
+  int i, w;
+
+  dg_setup();
+
+  ly_maxw = 1;
+  for (i = 0; i<decgraph_rows(dg); i++)
+  { w = dg->row_start[i+1] - dg->row_start[i];
+    if (w>ly_maxw) ly_maxw = w;
+  }
+
+  if (table==2)
+  { printf(
+     "  block  iter  changed  perrs    loglik   Eperrs   Eloglik  entropy\n");
+  }
+}
+
+/* Find bit probabilities from the posterior probability ratios. */
+
+static void ly_bitpr
+( int N,		/* Number of bits */
+  double *bprb		/* Place to store bit probabilities */
+)
+{
+  int j;
+
+  for (j = 0; j<N; j++)
+  { bprb[j] = 1 - 1/(1+ly_post[j]);
+  }
+}
+
+unsigned layered_decode
+( mod2sparse *H,	/* Parity check matrix */
+  double *lratio,	/* Likelihood ratios for bits */
+  char *dblk,		/* Place to store decoding */
+  char *pchk,		/* Place to store parity checks */
+  double *bprb		/* Place to store bit probabilities, 0 if not wanted */
+)
+{ 
+  double p;
+  int N, n, c, j, k;
+
+  N = mod2sparse_cols(H);
+
+  dg_alloc();
+
+  if (!ly_post)
+  { ly_post = chk_alloc (N, sizeof *ly_post);
+    ly_v = chk_alloc (ly_maxw, sizeof *ly_v);
+    ly_d = chk_alloc (ly_maxw, sizeof *ly_d);
+  }
+
+  /* Initialize posteriors and messages, and find initial guess. */
+
+  for (j = 0; j<N; j++)
+  { p = lratio[j];
+    if (!(p<=Ly_max_ratio)) p = Ly_max_ratio;   /* Also catches a NaN */
+    if (p<1/Ly_max_ratio) p = 1/Ly_max_ratio;
+    ly_post[j] = p;
+    dblk[j] = p>=1;
+  }
+
+  for (k = 0; k<decgraph_edges(dg); k++)
+  { dg_lr[k] = 1;
+  }
+
+  /* Do up to abs(max_iter) iterations, stopping early if a codeword is 
+     found, unless max_iter is negative. */
+
+  c = check(H,dblk,pchk);
+
+  for (n = 0; ; n++)
+  { 
+    if (table==2 && bprb)
+    { ly_bitpr(N,bprb);
+      printf("%7ld %5d %8.1f %6d %+9.2f %8.1f %+9.2f  %7.1f\n",
+       block_no, n, changed(lratio,dblk,N), c, loglikelihood(lratio,dblk,N), 
+       expected_parity_errors(H,bprb), expected_loglikelihood(lratio,bprb,N),
+       entropy(bprb,N));
+    }
+   
+    if (n==max_iter || n==-max_iter || (max_iter>0 && c==0))
+    { break; 
+    }
+
+    c += iterlayer(dg,dblk,pchk);
+  }
+
+  if (bprb) ly_bitpr(N,bprb);
+
+  return n;
+}
+
+
+/* DO ONE ITERATION OF LAYERED PROBABILITY PROPAGATION.  Updates the 
+   decoding and its parity checks, and returns the change in the number 
+   that fail. */
+
+int iterlayer
+( decgraph *g,		/* Decoding graph */
+  char *dblk,		/* Current decoding, updated */
+  char *pchk		/* Parity checks for the decoding, updated */
+)
+{
+  double dl, t, p;
+  double *lrs;
+  int *edge_col;
+  int M;
+  int i, j, k, kf, w, n, c;
+
+  M = decgraph_rows(g);
+
+  lrs = dg_lr;
+  edge_col = g->edge_col;
+
+  c = 0;
+
+  for (i = 0; i<M; i++)
+  { 
+    kf = g->row_start[i];
+    w = g->row_start[i+1] - kf;
+
+    /* Find messages from bits, and the products of the terms for those
+       before each one. */
+
+    dl = 1;
+    for (n = 0; n<w; n++)
+    { ly_v[n] = ly_post[edge_col[kf+n]] / lrs[kf+n];
+      ly_d[n] = 2/(1+ly_v[n]) - 1;
+      lrs[kf+n] = dl;
+      dl *= ly_d[n];
+    }
+
+    /* Multiply in the products for those after, to get new messages from 
+       the check, and update the posteriors of the bits. */
+
+    dl = 1;
+    for (n = w-1; n>=0; n--)
+    { k = kf+n;
+      t = lrs[k] * dl;
+      dl *= ly_d[n];
+      if (t>Ly_max_t) t = Ly_max_t;
+      if (t<-Ly_max_t) t = -Ly_max_t;
+      lrs[k] = (1-t)/(1+t);
+      p = ly_v[n] * lrs[k];
+      if (p>Ly_max_ratio) p = Ly_max_ratio;
+      if (p<1/Ly_max_ratio) p = 1/Ly_max_ratio;
+      j = edge_col[k];
+      ly_post[j] = p;
+      if ((p>=1)!=dblk[j]) c += dg_flip(g,j,dblk,pchk);
+    }
+  }
+
+  return c;
+}
+
+
+/* DECODE A BATCH OF BLOCKS BY MIN-SUM MESSAGE PASSING.  Decodes up to 
+   Dec_batch blocks at once, with the same method as minsum_decode, but in
+   single precision.  All the blocks share the decoding graph, so the 
+   messages for an edge are stored for all blocks together, and each step 
+   of the computation is a loop over the blocks that the compiler can turn 
+   into operations on vectors of floats (eight or sixteen of them at a time 
+   on processors with 256 or 512 bit vector registers).
+
+   The likelihood ratios for block b are lratio[b*N] to lratio[b*N+N-1], and
+   its decoding, parity checks and bit probabilities (if bprb isn't zero) are
+   stored at the corresponding places in dblk, pchk, and bprb.  The number
+   of iterations done for block b is stored in iters[b].  A block stops being
+   decoded (its results are saved, though the computation for it continues 
+   along with the others) when it would have stopped in minsum_decode.  The
+   parity checks for each block are found along with the messages, so the 
+   check procedure is not used. 
+
+   Detailed traces are not produced.  The setup procedure immediately below
+   compiles the decoding graph (as for prprp_decode_setup).  Space for the 
+   messages and other data for a batch is allocated when a thread first
+   decodes a batch.
+*/
+
+static _Thread_local float *bt_pr, *bt_lr; /* Messages for each edge and 
+					      block */
+static _Thread_local float *bt_llr;	/* Log likelihood ratios from the 
+					   channel */
+static _Thread_local float *bt_post;	/* Posterior log likelihood ratios */
+static _Thread_local char *bt_dblk;	/* Current decodings */
+static _Thread_local char *bt_pchk;	/* Current parity checks */
+
+void minsum_decode_batch_setup (void)
+{
+  dg_setup();
+}
+
+void minsum_decode_batch
+( mod2sparse *H,	/* Parity check matrix */
+  int nb,		/* Number of blocks, from 1 to Dec_batch */
+  double *lratio,	/* Likelihood ratios for bits of all blocks */
+  char *dblk,		/* Place to store decodings */
+  char *pchk,		/* Place to store parity checks */
+  double *bprb,		/* Place to store bit probabilities, 0 if not wanted */
+  unsigned *iters	/* Place to store number of iterations for each block */
+)
+{
+  float min1[Dec_batch], min2[Dec_batch], c1[Dec_batch], c2[Dec_batch];
+  float sgn[Dec_batch], t[Dec_batch];
+  int c[Dec_batch];
+  char done[Dec_batch];
+  float corr, a, u;
+  int *col_edge, *edge_col;
+  int M, N, n, n_done;
+  int b, i, j, k, e, kf, kl;
+  double l;
+
+  M = decgraph_rows(dg);
+  N = decgraph_cols(dg);
+
+  if (nb<1 || nb>Dec_batch || mod2sparse_rows(H)!=M || mod2sparse_cols(H)!=N)
+  { abort();
+  }
+
+  if (!bt_pr)
+  { bt_pr = chk_alloc (decgraph_edges(dg)*Dec_batch+1, sizeof *bt_pr);
+    bt_lr = chk_alloc (decgraph_edges(dg)*Dec_batch+1, sizeof *bt_lr);
+    bt_llr  = chk_alloc (N*Dec_batch, sizeof *bt_llr);
+    bt_post = chk_alloc (N*Dec_batch, sizeof *bt_post);
+    bt_dblk = chk_alloc (N*Dec_batch, sizeof *bt_dblk);
+    bt_pchk = chk_alloc (M*Dec_batch, sizeof *bt_pchk);
+  }
+
+  col_edge = dg->col_edge;
+  edge_col = dg->edge_col;
+  corr = ms_corr;
+
+  /* Initialize messages.  Unused places in the batch are given the channel
+     data for a block of zeros, which is immediately a codeword. */
+
+  for (j = 0; j<N; j++)
+  { for (b = 0; b<Dec_batch; b++)
+    { if (b<nb)
+      { l = -log(lratio[b*N+j]);
+        if (!(l<=Ms_max_llr)) l = Ms_max_llr;   /* Also catches a NaN */
+        if (l<-Ms_max_llr) l = -Ms_max_llr;
+      }
+      else
+      { l = Ms_max_llr;
+      }
+      bt_llr[j*Dec_batch+b] = l;
+      bt_post[j*Dec_batch+b] = l;
+      bt_dblk[j*Dec_batch+b] = l<=0;
+    }
+    kl = dg->col_start[j+1];
+    for (k = dg->col_start[j]; k<kl; k++)
+    { e = col_edge[k];
+      for (b = 0; b<Dec_batch; b++)
+      { bt_pr[e*Dec_batch+b] = bt_llr[j*Dec_batch+b];
+        bt_lr[e*Dec_batch+b] = 0;
+      }
+    }
+  }
+
+  for (b = 0; b<Dec_batch; b++) 
+  { done[b] = b>=nb;
+  }
+  n_done = Dec_batch-nb;
+
+  for (n = 0; ; n++)
+  {
+    /* Find the parity checks for the current decodings. */
+
+    for (b = 0; b<Dec_batch; b++) c[b] = 0;
+
+    for (i = 0; i<M; i++)
+    { char *p = bt_pchk + i*Dec_batch;
+      for (b = 0; b<Dec_batch; b++) p[b] = 0;
+      kl = dg->row_start[i+1];
+      for (k = dg->row_start[i]; k<kl; k++)
+      { char *d = bt_dblk + edge_col[k]*Dec_batch;
+        for (b = 0; b<Dec_batch; b++) p[b] ^= d[b];
+      }
+      for (b = 0; b<Dec_batch; b++) c[b] += p[b];
+    }
+
+    /* Save the results for blocks that are now finished. */
+
+    for (b = 0; b<nb; b++)
+    { if (!done[b] && (n==max_iter || n==-max_iter || (max_iter>0 && c[b]==0)))
+      { for (j = 0; j<N; j++)
+        { dblk[b*N+j] = bt_dblk[j*Dec_batch+b];
+          if (bprb) bprb[b*N+j] = 1/(1+exp(bt_post[j*Dec_batch+b]));
+        }
+        for (i = 0; i<M; i++)
+        { pchk[b*M+i] = bt_pchk[i*Dec_batch+b];
+        }
+        iters[b] = n;
+        done[b] = 1;
+        n_done += 1;
+      }
+    }
+
+    if (n_done==Dec_batch) break;
+
+    /* Recompute messages from checks, as in iterms.  Rather than recording
+       which edge has the smallest incoming magnitude, the edges that get 
+       the second smallest are found by comparing with the smallest, which
+       gives the same result when there are ties, since the two are then 
+       equal.  Signs are kept as +1 or -1, and all the computations are 
+       done with selects, so that the loops over blocks vectorize. */
+
+    for (i = 0; i<M; i++)
+    { kf = dg->row_start[i];
+      kl = dg->row_start[i+1];
+      for (b = 0; b<Dec_batch; b++)
+      { min1[b] = min2[b] = Ms_max_llr;
+        sgn[b] = 1;
+      }
+      for (k = kf; k<kl; k++)
+      { float *v = bt_pr + k*Dec_batch;
+        for (b = 0; b<Dec_batch; b++)
+        { a = v[b];
+          sgn[b] = a<0 ? -sgn[b] : sgn[b];
+          a = fabsf(a);
+          u = a>min1[b] ? a : min1[b];
+          min2[b] = u<min2[b] ? u : min2[b];
+          min1[b] = a<min1[b] ? a : min1[b];
+        }
+      }
+      if (dec_method==Minsum_offset)
+      { for (b = 0; b<Dec_batch; b++)
+        { c1[b] = sgn[b] * (min1[b]>corr ? min1[b]-corr : 0);
+          c2[b] = sgn[b] * (min2[b]>corr ? min2[b]-corr : 0);
+        }
+      }
+      else
+      { for (b = 0; b<Dec_batch; b++)
+        { c1[b] = sgn[b] * corr * min1[b];
+          c2[b] = sgn[b] * corr * min2[b];
+        }
+      }
+      for (k = kf; k<kl; k++)
+      { float *v = bt_pr + k*Dec_batch;
+        float *w = bt_lr + k*Dec_batch;
+        for (b = 0; b<Dec_batch; b++)
+        { a = fabsf(v[b])==min1[b] ? c2[b] : c1[b];
+          w[b] = v[b]<0 ? -a : a;
+        }
+      }
+    }
+
+    /* Recompute messages from bits and the decodings, as in iterms. */
+
+    for (j = 0; j<N; j++)
+    { kf = dg->col_start[j];
+      kl = dg->col_start[j+1];
+      for (b = 0; b<Dec_batch; b++)
+      { t[b] = bt_llr[j*Dec_batch+b];
+      }
+      for (k = kf; k<kl; k++)
+      { float *w = bt_lr + col_edge[k]*Dec_batch;
+        for (b = 0; b<Dec_batch; b++) t[b] += w[b];
+      }
+      for (b = 0; b<Dec_batch; b++)
+      { bt_post[j*Dec_batch+b] = t[b];
+        bt_dblk[j*Dec_batch+b] = t[b]<=0;
+      }
+      for (k = kf; k<kl; k++)
+      { float *v = bt_pr + col_edge[k]*Dec_batch;
+        float *w = bt_lr + col_edge[k]*Dec_batch;
+        for (b = 0; b<Dec_batch; b++) v[b] = t[b] - w[b];
+      }
+    }
+  }
+}
+
+
+/* DECODE BY MIN-SUM MESSAGE PASSING WITH 8-BIT MESSAGES.  Does the same 
+   computation as minsum_decode, with normalization by ms_corr, but with log
+   likelihood ratios quantized to signed 8-bit integers in units of Q8_unit, 
+   saturating at plus or minus Q8_max.  The log likelihood ratios from the 
+   channel are quantized once at the start, the sums over checks for a bit
+   are done in integers (which fit in the 16 bits kept for the posterior), 
+   and the result is saturated before being sent to a check.  The scale 
+   factor is applied as a multiplication by ms_corr in sixteenths, followed 
+   by a rounding shift.
+
+   Messages take an eighth of the space of those in dg_pr and dg_lr, and 
+   so more of them fit in cache, and in a vector register when blocks are 
+   decoded in batches by minsum_q8_decode_batch, below.  The loss from 
+   quantization is small, since the magnitudes that matter for min-sum are
+   those of the smallest messages into a check, which are well within the
+   range represented.  The setup procedure checks that no bit is in so many
+   checks that the sums can overflow 16 bits.
+
+   Iterations stop as described for prprp_decode, and the decoding, parity
+   checks and bit probabilities are returned in the same way.
+*/
+
+#define Q8_unit 0.125		/* Log likelihood ratio for a step of one */
+#define Q8_max 127		/* Largest magnitude of a quantized value */
+
+static int q8_scale;		/* Scale factor in sixteenths */
+
+static _Thread_local signed char *q8_pr;   /* Messages from bits to checks */
+static _Thread_local signed char *q8_lr;   /* Messages from checks to bits */
+static _Thread_local signed char *q8_llr;  /* Quantized log likelihood 
+					      ratios from the channel */
+static _Thread_local short *q8_post;	   /* Posterior log likelihood ratios, 
+					      not saturated */
+
+void minsum_q8_decode_setup (void)
+{
+  int j;
+
+  dg_setup();
+
+  for (j = 0; j<decgraph_cols(dg); j++)
+  { if (dg->col_start[j+1]-dg->col_start[j] > 32767/Q8_max - 1)
+    { fprintf(stderr,
+        "Bit %d is in too many checks for 8-bit decoding (%d)\n",
+        j, dg->col_start[j+1]-dg->col_start[j]);
+      exit(1);
+    }
+  }
+
+  q8_scale = (int) (ms_corr*16 + 0.5);
+
+  if (table==2)
+  { printf(
+     "  block  iter  changed  perrs    loglik   Eperrs   Eloglik  entropy\n");
+  }
+}
+
+/* Find bit probabilities from the posterior log likelihood ratios. */
+
+static void q8_bitpr
+( int N,		/* Number of bits */
+  double *bprb		/* Place to store bit probabilities */
+)
+{
+  int j;
+
+  for (j = 0; j<N; j++)
+  { bprb[j] = 1/(1+exp(q8_post[j]*Q8_unit));
+  }
+}
+
+unsigned minsum_q8_decode
+( mod2sparse *H,	/* Parity check matrix */
+  double *lratio,	/* Likelihood ratios for bits */
+  char *dblk,		/* Place to store decoding */
+  char *pchk,		/* Place to store parity checks */
+  double *bprb		/* Place to store bit probabilities, 0 if not wanted */
+)
+{ 
+  int N, n, c;
+
+  N = mod2sparse_cols(H);
+
+  if (!q8_pr)
+  { q8_pr   = chk_alloc (decgraph_edges(dg), sizeof *q8_pr);
+    q8_lr   = chk_alloc (decgraph_edges(dg), sizeof *q8_lr);
+    q8_llr  = chk_alloc (N, sizeof *q8_llr);
+    q8_post = chk_alloc (N, sizeof *q8_post);
+  }
+
+  /* Initialize messages, and find initial guess. */
+
+  initq8(dg,lratio,dblk);
+
+  /* Do up to abs(max_iter) iterations, stopping early if a codeword is 
+     found, unless max_iter is negative. */
+
+  c = check(H,dblk,pchk);
+
+  for (n = 0; ; n++)
+  { 
+    if (table==2 && bprb)
+    { q8_bitpr(N,bprb);
+      printf("%7ld %5d %8.1f %6d %+9.2f %8.1f %+9.2f  %7.1f\n",
+       block_no, n, changed(lratio,dblk,N), c, loglikelihood(lratio,dblk,N), 
+       expected_parity_errors(H,bprb), expected_loglikelihood(lratio,bprb,N),
+       entropy(bprb,N));
+    }
+   
+    if (n==max_iter || n==-max_iter || (max_iter>0 && c==0))
+    { break; 
+    }
+
+    c += iterq8(dg,dblk,pchk);
+  }
+
+  if (bprb) q8_bitpr(N,bprb);
+
+  return n;
+}
+
+
+/* INITIALIZE 8-BIT MIN-SUM DECODING.  Quantizes the log likelihood ratios 
+   from the channel, stores them as the initial messages from bits to checks,
+   and finds the initial guess at decoding. */
+
+void initq8
+( decgraph *g,		/* Decoding graph */
+  double *lratio,	/* Likelihood ratios for bits */
+  char *dblk		/* Place to store decoding */
+)
+{ 
+  double l;
+  int *col_edge;
+  int N;
+  int j, k, kl;
+
+  N = decgraph_cols(g);
+  col_edge = g->col_edge;
+
+  for (j = 0; j<N; j++)
+  { l = -log(lratio[j]) / Q8_unit;
+    if (!(l<=Q8_max)) l = Q8_max;   /* Also catches a NaN */
+    if (l<-Q8_max) l = -Q8_max;
+    q8_llr[j] = (signed char) lrint(l);
+    q8_post[j] = q8_llr[j];
+    kl = g->col_start[j+1];
+    for (k = g->col_start[j]; k<kl; k++)
+    { q8_pr[col_edge[k]] = q8_llr[j];
+      q8_lr[col_edge[k]] = 0;
+    }
+    dblk[j] = q8_llr[j]<=0;
+  }
+}
+
+
+/* DO ONE ITERATION OF 8-BIT MIN-SUM DECODING.  Updates the decoding and
+   its parity checks, and returns the change in the number that fail. */
+
+int iterq8
+( decgraph *g,		/* Decoding graph */
+  char *dblk,		/* Current decoding, updated */
+  char *pchk		/* Parity checks for the decoding, updated */
+)
+{
+  signed char *prs, *lrs;
+  int *row_start, *col_start, *col_edge;
+  int a, min1, min2, m1, m2, s, t;
+  int N, M;
+  int i, j, k, kf, kl, kmin, c;
+
+  M = decgraph_rows(g);
+  N = decgraph_cols(g);
+
+  prs = q8_pr;
+  lrs = q8_lr;
+  row_start = g->row_start;	/* Local copies, since stores through char */
+  col_start = g->col_start;	/*   pointers could otherwise change them   */
+  col_edge = g->col_edge;
+
+  /* Recompute messages from checks, using the two smallest magnitudes of 
+     the incoming messages and the parity of their signs. */
+
+  for (i = 0; i<M; i++)
+  { kf = row_start[i];
+    kl = row_start[i+1];
+    min1 = min2 = Q8_max;
+    kmin = -1;
+    s = 0;
+    for (k = kf; k<kl; k++)
+    { a = prs[k];
+      s ^= a;
+      a = abs(a);
+      t = a>min1 ? a : min1;
+      min2 = t<min2 ? t : min2;
+      kmin = a<min1 ? k : kmin;
+      min1 = a<min1 ? a : min1;
+    }
+    m1 = (min1*q8_scale + 8) >> 4;
+    m2 = (min2*q8_scale + 8) >> 4;
+    s >>= 31;			/* All ones if product of signs is negative */
+    for (k = kf; k<kl; k++)
+    { t = s ^ (prs[k]>>31);	/* Negates with no branch if t is -1 */
+      lrs[k] = (m1^t) - t;
+    }
+    if (kmin>=0)
+    { t = s ^ (prs[kmin]>>31);
+      lrs[kmin] = (m2^t) - t;
+    }
+  }
+
+  /* Recompute messages from bits, which exclude the message from the check
+     they are sent to, saturating them to 8 bits.  Also find the next guess 
+     based on the signs of the posterior log likelihood ratios. */
+
+  c = 0;
+
+  for (j = 0; j<N; j++)
+  { kf = col_start[j];
+    kl = col_start[j+1];
+    t = q8_llr[j];
+    for (k = kf; k<kl; k++)
+    { t += lrs[col_edge[k]];
+    }
+    q8_post[j] = t;
+    if ((t<=0)!=dblk[j]) c += dg_flip(g,j,dblk,pchk);
+    for (k = kf; k<kl; k++)
+    { a = t - lrs[col_edge[k]];
+      a = a>Q8_max ? Q8_max : a;
+      a = a<-Q8_max ? -Q8_max : a;
+      prs[col_edge[k]] = a;
+    }
+  }
+
+  return c;
+}
+
+
+
+/* DECODE A BATCH OF BLOCKS BY 8-BIT MIN-SUM MESSAGE PASSING.  Decodes up to
+   Dec_batch blocks at once, with the same computation as minsum_q8_decode,
+   and with the messages for an edge stored for all blocks together, as in
+   minsum_decode_batch.  The arguments and results are as for that procedure,
+   and the results for each block are the same as minsum_q8_decode would 
+   give.  The setup procedure is minsum_q8_decode_setup.
+
+   The values for an edge or bit for all the blocks are kept in vectors of
+   bytes (or of 16-bit integers for sums), using the vector extensions of 
+   gcc and clang, so that each step is done for sixteen blocks by one or a 
+   few instructions, even with only SSE2.  (Loops over bytes, written as 
+   for minsum_decode_batch, aren't vectorized by gcc.)  Selections are done 
+   with masks found by comparisons, since the ?: operator can't be used with
+   vectors in C.  The vector types are declared with an alignment of one, 
+   so the arrays holding them may be allocated anywhere.
+*/
+
+typedef signed char q8_vec	/* Bytes for all blocks */
+  __attribute__ ((vector_size (Dec_batch), aligned (1)));
+typedef short q8_wide		/* 16-bit integers for all blocks */
+  __attribute__ ((vector_size (2*Dec_batch), aligned (1)));
+
+#define q8_select(m,a,b) (((m)&(a)) | (~(m)&(b))) /* a where m is all ones */
+
+static _Thread_local q8_vec *qb_pr, *qb_lr; /* Messages for each edge */
+static _Thread_local q8_vec *qb_llr;	/* Quantized log likelihood ratios 
+					   from the channel */
+static _Thread_local q8_wide *qb_post;	/* Posterior log likelihood ratios */
+static _Thread_local q8_vec *qb_dblk;	/* Current decodings */
+static _Thread_local q8_vec *qb_pchk;	/* Current parity checks */
+
+void minsum_q8_decode_batch
+( mod2sparse *H,	/* Parity check matrix */
+  int nb,		/* Number of blocks, from 1 to Dec_batch */
+  double *lratio,	/* Likelihood ratios for bits of all blocks */
+  char *dblk,		/* Place to store decodings */
+  char *pchk,		/* Place to store parity checks */
+  double *bprb,		/* Place to store bit probabilities, 0 if not wanted */
+  unsigned *iters	/* Place to store number of iterations for each block */
+)
+{
+  q8_vec min1, min2, m1, m2, sgn, x, s, a, u, m, p;
+  q8_wide t, y, w, lo, hi;
+  short scale;
+  int c[Dec_batch];
+  char done[Dec_batch];
+  int *row_start, *col_start, *col_edge, *edge_col;
+  int M, N, n, n_done, q;
+  int b, i, j, k, e, kf, kl;
+  double l;
+
+  M = decgraph_rows(dg);
+  N = decgraph_cols(dg);
+
+  if (nb<1 || nb>Dec_batch || mod2sparse_rows(H)!=M || mod2sparse_cols(H)!=N)
+  { abort();
+  }
+
+  if (!qb_pr)
+  { qb_pr = chk_alloc (decgraph_edges(dg)+1, sizeof *qb_pr);
+    qb_lr = chk_alloc (decgraph_edges(dg)+1, sizeof *qb_lr);
+    qb_llr  = chk_alloc (N, sizeof *qb_llr);
+    qb_post = chk_alloc (N, sizeof *qb_post);
+    qb_dblk = chk_alloc (N, sizeof *qb_dblk);
+    qb_pchk = chk_alloc (M, sizeof *qb_pchk);
+  }
+
+  row_start = dg->row_start;
+  col_start = dg->col_start;
+  col_edge = dg->col_edge;
+  edge_col = dg->edge_col;
+
+  scale = q8_scale;
+  lo = (q8_wide) {0} - Q8_max;
+  hi = (q8_wide) {0} + Q8_max;
+
+  /* Initialize messages, as in initq8.  Unused places in the batch are given
+     the channel data for a block of zeros, which is immediately a codeword. */
+
+  for (j = 0; j<N; j++)
+  { for (b = 0; b<Dec_batch; b++)
+    { if (b<nb)
+      { l = -log(lratio[b*N+j]) / Q8_unit;
+        if (!(l<=Q8_max)) l = Q8_max;   /* Also catches a NaN */
+        if (l<-Q8_max) l = -Q8_max;
+        q = (int) lrint(l);
+      }
+      else
+      { q = Q8_max;
+      }
+      qb_llr[j][b] = q;
+    }
+    qb_post[j] = __builtin_convertvector (qb_llr[j], q8_wide);
+    qb_dblk[j] = -(qb_llr[j]<=0);
+    kl = col_start[j+1];
+    for (k = col_start[j]; k<kl; k++)
+    { e = col_edge[k];
+      qb_pr[e] = qb_llr[j];
+      qb_lr[e] = (q8_vec) {0};
+    }
+  }
+
+  for (b = 0; b<Dec_batch; b++) 
+  { done[b] = b>=nb;
+  }
+  n_done = Dec_batch-nb;
+
+  for (n = 0; ; n++)
+  {
+    /* Find the parity checks for the current decodings. */
+
+    for (b = 0; b<Dec_batch; b++) c[b] = 0;
+
+    for (i = 0; i<M; i++)
+    { p = (q8_vec) {0};
+      kl = row_start[i+1];
+      for (k = row_start[i]; k<kl; k++)
+      { p ^= qb_dblk[edge_col[k]];
+      }
+      qb_pchk[i] = p;
+      for (b = 0; b<Dec_batch; b++) c[b] += p[b];
+    }
+
+    /* Save the results for blocks that are now finished. */
+
+    for (b = 0; b<nb; b++)
+    { if (!done[b] && (n==max_iter || n==-max_iter || (max_iter>0 && c[b]==0)))
+      { for (j = 0; j<N; j++)
+        { dblk[b*N+j] = qb_dblk[j][b];
+          if (bprb) bprb[b*N+j] = 1/(1+exp(qb_post[j][b]*Q8_unit));
+        }
+        for (i = 0; i<M; i++)
+        { pchk[b*M+i] = qb_pchk[i][b];
+        }
+        iters[b] = n;
+        done[b] = 1;
+        n_done += 1;
+      }
+    }
+
+    if (n_done==Dec_batch) break;
+
+    /* Recompute messages from checks, as in iterq8, except that every edge
+       with the smallest incoming magnitude gets the second smallest, as in
+       minsum_decode_batch, which is the same when there are ties.  The sign
+       of the product of the incoming messages is that of the exclusive-or 
+       of them all. */
+
+    for (i = 0; i<M; i++)
+    { kf = row_start[i];
+      kl = row_start[i+1];
+      min1 = min2 = (q8_vec) {0} + Q8_max;
+      sgn = (q8_vec) {0};
+      for (k = kf; k<kl; k++)
+      { x = qb_pr[k];
+        sgn ^= x;
+        s = x<0;		/* All ones where x is negative */
+        a = (x^s) - s;
+        m = a<min1;
+        u = q8_select(m,min1,a);
+        min1 = q8_select(m,a,min1);
+        min2 = q8_select(u<min2,u,min2);
+      }
+      w = (__builtin_convertvector (min1, q8_wide) * scale + 8) >> 4;
+      m1 = __builtin_convertvector (w, q8_vec);
+      w = (__builtin_convertvector (min2, q8_wide) * scale + 8) >> 4;
+      m2 = __builtin_convertvector (w, q8_vec);
+      for (k = kf; k<kl; k++)
+      { x = qb_pr[k];
+        s = x<0;
+        a = (x^s) - s;
+        a = q8_select(a==min1,m2,m1);
+        s = (sgn^x)<0;		/* Negates with no branch where s is -1 */
+        qb_lr[k] = (a^s) - s;
+      }
+    }
+
+    /* Recompute messages from bits and the decodings, as in iterq8.  Sums
+       are in vectors of 16-bit integers, which are longer than a register 
+       with only SSE2, and for which gcc then does comparisons one element 
+       at a time.  So they are compared with zero by looking at the sign 
+       bit, with an arithmetic shift giving all ones where a value is 
+       negative.  This is used to saturate the messages to Q8_max, and to
+       find the decodings from whether t-1 is negative. */
+
+    for (j = 0; j<N; j++)
+    { kf = col_start[j];
+      kl = col_start[j+1];
+      t = __builtin_convertvector (qb_llr[j], q8_wide);
+      for (k = kf; k<kl; k++)
+      { t += __builtin_convertvector (qb_lr[col_edge[k]], q8_wide);
+      }
+      qb_post[j] = t;
+      qb_dblk[j] = __builtin_convertvector (-((t-1)>>15), q8_vec);
+      for (k = kf; k<kl; k++)
+      { e = col_edge[k];
+        y = t - __builtin_convertvector (qb_lr[e], q8_wide);
+        w = y - hi;
+        y = hi + (w & (w>>15));
+        w = y - lo;
+        y = y - (w & (w>>15));
+        qb_pr[e] = __builtin_convertvector (y, q8_vec);
+      }
+    }
+  }
+}
+
+
+/* DECODE A BATCH OF BLOCKS BY BIT FLIPPING.  A cheap first try at decoding,
+   for channels where most blocks have few errors, using only the decoding 
+   from the likelihood ratios for each bit alone (the "received" bits).  
+
+   This is Gallager's algorithm B, in which messages are single bits.  A 
+   check sends to each of its bits the value that would satisfy the check, 
+   given the messages from its other bits.  A bit sends to a check its 
+   received value, unless the messages from its other checks that disagree
+   with it number more than half of all its checks (so a bit in only two
+   checks always sends its received value).  The decoding for a bit is its
+   received value, unless more than half of the messages from its checks 
+   disagree with it.  
+   Iterations stop when all checks are satisfied, or after Bf_max_iter 
+   iterations.
+
+   Up to Bf_batch blocks are decoded at once, bit-sliced, with bit b of the
+   64-bit words used being for block b.  Numbers of messages that disagree
+   are counted in words holding one bit of the counts for all blocks.  A 
+   block's decoding stops being changed once its checks are all satisfied.
+
+   The likelihood ratios for block b are lratio[b*N] to lratio[b*N+N-1], and
+   its decoding is stored at the corresponding places in dblk.  Whether all
+   checks were satisfied for block b is stored in ok[b], and the number of 
+   iterations done for it in iters[b].  Blocks that were not decoded are 
+   meant to be decoded again by one of the methods above.  
+
+   The setup procedure immediately below compiles the decoding graph (as for
+   prprp_decode_setup), and finds how many bits the counts need.  Space for
+   a batch is allocated when a thread first decodes a batch. 
+*/
+
+#define Bf_max_iter 20		/* Maximum number of iterations */
+
+static int bf_nbits;		/* Number of bits in counts of messages */
+
+static _Thread_local uint64_t *bf_recv;	/* Received bits, bit-sliced */
+static _Thread_local uint64_t *bf_dblk;	/* Current decodings */
+static _Thread_local uint64_t *bf_msg;	/* Messages for each edge */
+
+void bitflip_decode_batch_setup (void)
+{
+  int j, w;
+
+  dg_setup();
+
+  bf_nbits = 1;
+  for (j = 0; j<decgraph_cols(dg); j++)
+  { w = dg->col_start[j+1] - dg->col_start[j];
+    while ((w>>bf_nbits)!=0) bf_nbits += 1;
+  }
+}
+
+/* Find which of the bit-sliced counts in cnt are greater than t. */
+
+static uint64_t bf_greater
+( uint64_t *cnt,	/* Bits of counts, low-order first */
+  int t			/* Value to compare with */
+)
+{
+  uint64_t gt, eq;
+  int p;
+
+  if (t<0) return ~(uint64_t)0;
+
+  gt = 0;
+  eq = ~(uint64_t)0;
+
+  for (p = bf_nbits-1; p>=0; p--)
+  { if ((t>>p)&1)
+    { eq &= cnt[p];
+    }
+    else
+    { gt |= eq & cnt[p];
+      eq &= ~cnt[p];
+    }
+  }
+
+  return gt;
+}
+
+void bitflip_decode_batch
+( mod2sparse *H,	/* Parity check matrix */
+  int nb,		/* Number of blocks, from 1 to Bf_batch */
+  double *lratio,	/* Likelihood ratios for bits of all blocks */
+  char *dblk,		/* Place to store decodings */
+  char *ok,		/* Place to store whether each block was decoded */
+  unsigned *iters	/* Place to store number of iterations for each block */
+)
+{
+  uint64_t cnt[8*sizeof(int)];
+  uint64_t lanes, done, fail, c, x, y, s, g1, g2;
+  int *row_start, *edge_col, *col_start, *col_edge;
+  int N, M;
+  int b, i, j, k, kf, kl, n, p, w;
+
+  M = decgraph_rows(dg);
+  N = decgraph_cols(dg);
+
+  row_start = dg->row_start;
+  edge_col = dg->edge_col;
+  col_start = dg->col_start;
+  col_edge = dg->col_edge;
+
+  if (nb<1 || nb>Bf_batch || mod2sparse_rows(H)!=M || mod2sparse_cols(H)!=N)
+  { abort();
+  }
+
+  if (!bf_recv)
+  { bf_recv = chk_alloc (N, sizeof *bf_recv);
+    bf_dblk = chk_alloc (N, sizeof *bf_dblk);
+    bf_msg = chk_alloc (decgraph_edges(dg)+1, sizeof *bf_msg);
+  }
+
+  lanes = nb==64 ? ~(uint64_t)0 : ((uint64_t)1<<nb) - 1;
+
+  /* Find the received bits, which are the initial decodings and messages. */
+
+  for (j = 0; j<N; j++)
+  { x = 0;
+    for (b = 0; b<nb; b++)
+    { x |= (uint64_t)(lratio[b*N+j]>=1) << b;
+    }
+    bf_recv[j] = x;
+    bf_dblk[j] = x;
+    kl = col_start[j+1];
+    for (k = col_start[j]; k<kl; k++)
+    { bf_msg[col_edge[k]] = x;
+    }
+  }
+
+  done = 0;
+
+  for (n = 0; ; n++)
+  { 
+    /* Find messages from checks, and which blocks have decodings that 
+       satisfy all checks. */
+
+    fail = 0;
+    for (i = 0; i<M; i++)
+    { kf = row_start[i];
+      kl = row_start[i+1];
+      x = 0;
+      s = 0;
+      for (k = kf; k<kl; k++)
+      { x ^= bf_msg[k];
+        s ^= bf_dblk[edge_col[k]];
+      }
+      for (k = kf; k<kl; k++)
+      { bf_msg[k] ^= x;
+      }
+      fail |= s;
+    }
+
+    for (b = 0; b<nb; b++)
+    { if (!((done>>b)&1)) iters[b] = n;
+    }
+
+    done |= ~fail & lanes;
+
+    if (done==lanes || n==Bf_max_iter) break;
+
+    /* Find messages from bits, and new decodings for blocks not done.  The
+       count of disagreeing messages from the other checks is more than half
+       if the count for all checks is more than half plus one, or is more 
+       than half and the message from this check agrees. */
+
+    for (j = 0; j<N; j++)
+    { 
+      kf = col_start[j];
+      kl = col_start[j+1];
+      w = kl - kf;
+      y = bf_recv[j];
+
+      for (p = 0; p<bf_nbits; p++) cnt[p] = 0;
+      for (k = kf; k<kl; k++)
+      { c = bf_msg[col_edge[k]] ^ y;
+        for (p = 0; p<bf_nbits && c!=0; p++)
+        { x = cnt[p] & c;
+          cnt[p] ^= c;
+          c = x;
+        }
+      }
+
+      bf_dblk[j] ^= (bf_dblk[j] ^ y ^ bf_greater(cnt,w/2)) & ~done;
+
+      g1 = bf_greater(cnt,w/2);
+      g2 = bf_greater(cnt,w/2+1);
+      for (k = kf; k<kl; k++)
+      { x = bf_msg[col_edge[k]] ^ y;
+        bf_msg[col_edge[k]] = y ^ (g2 | (g1 & ~x));
+      }
+    }
+  }
+
+  /* Store the decodings. */
+
+  for (b = 0; b<nb; b++)
+  { ok[b] = (done>>b)&1;
+  }
+
+  for (j = 0; j<N; j++)
+  { x = bf_dblk[j];
+    for (b = 0; b<nb; b++)
+    { dblk[b*N+j] = (x>>b)&1;
+    }
+  }
+}
+
+
+/* IMPROVE A FAILED DECODING BY ORDERED STATISTICS DECODING.  Finds a valid
+   codeword close to the received data, for a block where another method 
+   failed to find one.  The bits are ordered by how reliable the bit 
+   probabilities (bprb) found by that method are, and the parity check 
+   matrix is inverted for the least reliable set of bits that it can be 
+   inverted for.  The other bits, the "information set", determine the rest
+   of a codeword.  The codeword from the decodings of the information set is
+   tried, and then those with one bit of the information set flipped (for 
+   osd_order of 1 or more), and those with two flipped (osd_order of 2), 
+   starting with the least reliable bits.  The codeword that is most likely 
+   given the likelihood ratios from the channel (lratio) is stored in dblk.
+
+   The search stops early if it takes more than osd_budget seconds, with
+   the best codeword found so far.  The codewords tried are kept packed in
+   64-bit words, so trying one is mostly a few exclusive-ors, plus adding 
+   the log likelihood ratios of bits that disagree with the channel.  The
+   function value is the number of codewords tried.
+
+   The setup procedure immediately below checks that the parity check 
+   matrix (in the H global variable) has no redundant rows, as is needed
+   for the information set to determine a codeword.  Space is allocated 
+   when a thread first uses this procedure.
+*/
+
+int osd_order;		/* Number of bits flipped, -1 if not done */
+double osd_budget;	/* Time allowed for each block, in seconds */
+
+static _Thread_local mod2dense *os_H;	/* Parity check matrix */
+static _Thread_local mod2dense *os_D;	/* Matrix with columns reordered */
+static _Thread_local mod2dense *os_R;	/* Inverse found from os_D */
+static _Thread_local mod2dense *os_Ai;	/* Inverse for the least reliable bits */
+static _Thread_local mod2dense *os_B;	/* Columns for the information set */
+static _Thread_local mod2dense *os_G;	/* Changes to other bits when each bit
+					   of the information set is 1 */
+static _Thread_local double *os_rel;	/* Reliability of each bit */
+static _Thread_local int *os_order;	/* Bits, least reliable first */
+static _Thread_local int *os_rows;	/* Rows used in the inversion */
+static _Thread_local int *os_cols;	/* Columns used in the inversion */
+static _Thread_local int *os_pcol;	/* Bits found from the information set */
+static _Thread_local int *os_fcol;	/* Bits of the information set */
+static _Thread_local double *os_wp;	/* Costs of disagreeing with the 
+					   channel for bits in os_pcol */
+static _Thread_local double *os_df;	/* Changes in cost from flipping bits
+					   in os_fcol */
+static _Thread_local char *os_xf;	/* Decodings of the information set */
+static _Thread_local uint64_t *os_gen;	/* Columns of os_G, packed */
+static _Thread_local uint64_t *os_v;	/* Codewords being tried, packed, */
+static _Thread_local uint64_t *os_t;	/*   in bits not in the information */
+static _Thread_local uint64_t *os_best;	/*   set                            */
+
+void osd_setup (void)
+{
+  mod2dense *D, *R;
+  int *rows, *cols;
+  int r;
+
+  D = mod2dense_allocate(M,N);
+  R = mod2dense_allocate(M,N);
+  rows = chk_alloc (M, sizeof *rows);
+  cols = chk_alloc (N, sizeof *cols);
+
+  mod2sparse_to_dense(H,D);
+  r = mod2dense_invert_selected(D,R,rows,cols);
+
+  if (r!=0)
+  { fprintf(stderr,
+     "Ordered statistics decoding needs a parity check matrix with no redundant rows\n");
+    exit(1);
+  }
+
+  mod2dense_free(D);
+  mod2dense_free(R);
+  free(rows);
+  free(cols);
+}
+
+/* Compare bits by reliability, for sorting, with ties broken by index. */
+
+static int os_cmp
+( const void *a,
+  const void *b
+)
+{
+  int i, j;
+
+  i = *(const int *)a;
+  j = *(const int *)b;
+
+  return os_rel[i]<os_rel[j] ? -1 : os_rel[i]>os_rel[j] ? 1 : i-j;
+}
+
+/* Compare integers, for sorting. */
+
+static int os_cmp_int
+( const void *a,
+  const void *b
+)
+{
+  return *(const int *)a - *(const int *)b;
+}
+
+/* Find the cost of a codeword, as the total of log likelihood ratios for 
+   bits not in the information set that disagree with the channel (given
+   by which bits of v are set), plus the cost for the information set. */
+
+static double os_cost
+( uint64_t *v,		/* Disagreements, packed */
+  double cf		/* Cost for the information set */
+)
+{
+  uint64_t x;
+  int w;
+
+  for (w = 0; w<(M+63)/64; w++)
+  { for (x = v[w]; x!=0; x &= x-1)
+    { cf += os_wp[w*64+__builtin_ctzll(x)];
+    }
+  }
+
+  return cf;
+}
+
+/* Get the time, in seconds. */
+
+static double os_time (void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC,&t);
+
+  return t.tv_sec + 1e-9*t.tv_nsec;
+}
+
+unsigned osd_decode
+( mod2sparse *H,	/* Parity check matrix */
+  double *lratio,	/* Likelihood ratios for bits */
+  double *bprb,		/* Bit probabilities from another method */
+  char *dblk		/* Place to store decoding */
+)
+{
+  double p, l, cost, best, cf, start;
+  uint64_t *g, *g2;
+  int K, W, bf1, bf2;
+  int i, j, k, k2, w;
+  unsigned n;
+
+  K = N-M;
+  W = (M+63) / 64;
+
+  if (!os_H)
+  { os_H  = mod2dense_allocate(M,N);
+    os_D  = mod2dense_allocate(M,N);
+    os_R  = mod2dense_allocate(M,N);
+    os_Ai = mod2dense_allocate(M,M);
+    os_B  = mod2dense_allocate(M,K);
+    os_G  = mod2dense_allocate(M,K);
+    mod2sparse_to_dense(H,os_H);
+    os_rel   = chk_alloc (N, sizeof *os_rel);
+    os_order = chk_alloc (N, sizeof *os_order);
+    os_rows  = chk_alloc (M, sizeof *os_rows);
+    os_cols  = chk_alloc (N, sizeof *os_cols);
+    os_pcol  = chk_alloc (M, sizeof *os_pcol);
+    os_fcol  = chk_alloc (K, sizeof *os_fcol);
+    os_wp    = chk_alloc (W*64, sizeof *os_wp);
+    os_df    = chk_alloc (K, sizeof *os_df);
+    os_xf    = chk_alloc (K, sizeof *os_xf);
+    os_gen   = chk_alloc (K*W, sizeof *os_gen);
+    os_v     = chk_alloc (W, sizeof *os_v);
+    os_t     = chk_alloc (W, sizeof *os_t);
+    os_best  = chk_alloc (W, sizeof *os_best);
+  }
+
+  start = os_time();
+
+  /* Order the bits by reliability, least reliable first, and invert the
+     parity check matrix for the first set of them for which that is 
+     possible.  Since the columns are tried in order, these are about the
+     least reliable bits. */
+
+  for (j = 0; j<N; j++)
+  { p = bprb[j];
+    os_rel[j] = p>0.5 ? p : 1-p;
+    os_order[j] = j;
+  }
+
+  qsort (os_order, N, sizeof *os_order, os_cmp);
+
+  mod2dense_copycols(os_H,os_D,os_order);
+
+  if (mod2dense_invert_selected(os_D,os_R,os_rows,os_cols)!=0) abort();
+
+  mod2dense_copycols(os_R,os_Ai,os_cols);
+
+  for (i = 0; i<M; i++)
+  { os_pcol[i] = os_order[os_cols[i]];
+  }
+
+  /* Put the information set in order of reliability too (which is the 
+     order of the columns of os_D), so the bits flipped first are the least
+     reliable. */
+
+  qsort (os_cols+M, K, sizeof *os_cols, os_cmp_int);
+
+  for (k = 0; k<K; k++)
+  { os_fcol[k] = os_order[os_cols[M+k]];
+  }
+
+  /* Find the changes to the other bits from each bit of the information 
+     set, packed into words. */
+
+  mod2dense_copycols(os_H,os_B,os_fcol);
+  mod2dense_multiply(os_Ai,os_B,os_G);
+
+  for (k = 0; k<K; k++)
+  { g = os_gen + k*W;
+    for (w = 0; w<W; w++) g[w] = 0;
+    for (i = 0; i<M; i++)
+    { if (mod2dense_get(os_G,i,k)) g[i/64] |= (uint64_t)1 << (i%64);
+    }
+  }
+
+  /* Find the codeword from the decodings of the information set, recording
+     in os_t where its other bits disagree with the channel.  Also find the 
+     cost of the information set, and the change in this cost from flipping
+     each of its bits. */
+
+  for (w = 0; w<W; w++) 
+  { os_t[w] = 0;
+  }
+
+  for (i = 0; i<M; i++)
+  { l = log(lratio[os_pcol[i]]);
+    os_wp[i] = fabs(l);
+    if (l>0) os_t[i/64] ^= (uint64_t)1 << (i%64);
+  }
+
+  cf = 0;
+  for (k = 0; k<K; k++)
+  { l = log(lratio[os_fcol[k]]);
+    os_xf[k] = bprb[os_fcol[k]]>=0.5;
+    if (os_xf[k]!=(l>0))
+    { cf += fabs(l);
+      os_df[k] = -fabs(l);
+    }
+    else
+    { os_df[k] = fabs(l);
+    }
+    if (os_xf[k])
+    { g = os_gen + k*W;
+      for (w = 0; w<W; w++) os_t[w] ^= g[w];
+    }
+  }
+
+  best = os_cost(os_t,cf);
+  for (w = 0; w<W; w++) 
+  { os_best[w] = os_t[w];
+  }
+  bf1 = bf2 = -1;
+  n = 1;
+
+  /* Try flipping one bit of the information set, and then two, keeping 
+     the best codeword found, until done or out of time. */
+
+  if (osd_order>=1)
+  { for (k = 0; k<K; k++)
+    { g = os_gen + k*W;
+      for (w = 0; w<W; w++) os_v[w] = os_t[w] ^ g[w];
+      cost = os_cost(os_v,cf+os_df[k]);
+      if (cost<best)
+      { best = cost;
+        for (w = 0; w<W; w++) os_best[w] = os_v[w];
+        bf1 = k;
+        bf2 = -1;
+      }
+    }
+    n += K;
+  }
+
+  if (osd_order>=2)
+  { for (k2 = 1; k2<K; k2++)
+    { 
+      if (os_time()-start > osd_budget) break;
+
+      g2 = os_gen + k2*W;
+      for (k = 0; k<k2; k++)
+      { g = os_gen + k*W;
+        for (w = 0; w<W; w++) os_v[w] = os_t[w] ^ g[w] ^ g2[w];
+        cost = os_cost(os_v,cf+os_df[k]+os_df[k2]);
+        if (cost<best)
+        { best = cost;
+          for (w = 0; w<W; w++) os_best[w] = os_v[w];
+          bf1 = k;
+          bf2 = k2;
+        }
+      }
+      n += k2;
+    }
+  }
+
+  /* Store the best codeword found. */
+
+  for (k = 0; k<K; k++)
+  { dblk[os_fcol[k]] = os_xf[k] ^ (k==bf1 || k==bf2);
+  }
+
+  for (i = 0; i<M; i++)
+  { dblk[os_pcol[i]] = 
+      ((os_best[i/64]>>(i%64))&1) ^ (log(lratio[os_pcol[i]])>0);
+  }
+
+  return n;
+}
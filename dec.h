@@ -37,16 +37,24 @@
    declared here are located in dec.c. */
 
 typedef enum 
-{ Enum_block, Enum_bit, Prprp
+{ Enum_block, Enum_bit, Prprp, Minsum, Minsum_offset, Layered, Minsum_q8
 } decoding_method;
 
 extern decoding_method dec_method; /* Decoding method to use */
 
 extern int table;	/* Trace option, 2 for a table of decoding details */
-extern int block_no;	/* Number of current block, from zero */
+extern long block_no;	/* Number of current block, from zero */
 
 extern int max_iter;	/* Maximum number of iteratons of decoding to do */
 extern char *gen_file;	/* Generator file for Enum_block and Enum_bit */
+extern int enum_threads;	/* Number of threads for Enum_block and Enum_bit */
+
+extern int osd_order;	/* Bits flipped in ordered statistics decoding, 
+			   -1 if not done */
+extern double osd_budget; /* Time allowed for it for each block, in seconds */
+
+extern double ms_corr;	/* Scale factor for Minsum and Minsum_q8, or offset
+			   for Minsum_offset */
 
 
 /* PROCEDURES RELATING TO DECODING METHODS. */
@@ -58,5 +66,44 @@ void prprp_decode_setup (void);
 unsigned prprp_decode 
 (mod2sparse *, double *, char *, char *, double *);
 
-void initprp (mod2sparse *, double *, char *, double *);
-void iterprp (mod2sparse *, double *, char *, double *);
+void initprp (decgraph *, double *, char *, double *);
+int iterprp (decgraph *, double *, char *, char *, double *);
+
+void minsum_decode_setup (void);
+unsigned minsum_decode
+(mod2sparse *, double *, char *, char *, double *);
+
+void initms (decgraph *, double *, char *);
+int iterms (decgraph *, char *, char *);
+
+#define Dec_batch 16	/* Number of blocks decoded at once by 
+			   minsum_decode_batch and minsum_q8_decode_batch */
+
+void minsum_decode_batch_setup (void);
+void minsum_decode_batch 
+(mod2sparse *, int, double *, char *, char *, double *, unsigned *);
+
+void layered_decode_setup (void);
+unsigned layered_decode
+(mod2sparse *, double *, char *, char *, double *);
+
+int iterlayer (decgraph *, char *, char *);
+
+void minsum_q8_decode_setup (void);
+unsigned minsum_q8_decode
+(mod2sparse *, double *, char *, char *, double *);
+
+void initq8 (decgraph *, double *, char *);
+int iterq8 (decgraph *, char *, char *);
+
+void minsum_q8_decode_batch 
+(mod2sparse *, int, double *, char *, char *, double *, unsigned *);
+
+#define Bf_batch 64	/* Number of blocks decoded at once by 
+			   bitflip_decode_batch */
+
+void bitflip_decode_batch_setup (void);
+void bitflip_decode_batch 
+(mod2sparse *, int, double *, char *, char *, unsigned *);
+void osd_setup (void);
+unsigned osd_decode (mod2sparse *, double *, double *, char *);
@@ -0,0 +1,87 @@
+/* DECGRAPH.C - Procedures for compiled decoding graphs. */
+
+/* Copyright (c) 2014 by Allen Yu
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "mod2sparse.h"
+#include "decgraph.h"
+
+
+/* BUILD A DECODING GRAPH FROM A PARITY CHECK MATRIX.  The matrix is frozen,
+   if it isn't already, and its edges are then its entries, numbered as in 
+   mod2sparse.h.  It is not used by the graph after this, and may be freed. */
+
+decgraph *decgraph_build
+( mod2sparse *H		/* Parity check matrix */
+)
+{
+  decgraph *g;
+  mod2entry *e;
+  int M, N, n, k;
+
+  mod2sparse_freeze(H);
+
+  M = mod2sparse_rows(H);
+  N = mod2sparse_cols(H);
+  n = mod2sparse_row_start(H,M);
+
+  g = chk_alloc (1, sizeof *g);
+
+  g->n_rows = M;
+  g->n_cols = N;
+  g->n_edges = n;
+
+  g->row_start = chk_alloc (M+1, sizeof *g->row_start);
+  g->col_start = chk_alloc (N+1, sizeof *g->col_start);
+  g->edge_col = chk_alloc (n>0 ? n : 1, sizeof *g->edge_col);
+  g->edge_row = chk_alloc (n>0 ? n : 1, sizeof *g->edge_row);
+  g->col_edge = chk_alloc (n>0 ? n : 1, sizeof *g->col_edge);
+
+  memcpy (g->row_start, &mod2sparse_row_start(H,0), (M+1) * sizeof *g->row_start);
+  memcpy (g->col_start, &mod2sparse_col_start(H,0), (N+1) * sizeof *g->col_start);
+  memcpy (g->col_edge, &mod2sparse_col_entry(H,0), n * sizeof *g->col_edge);
+
+  for (k = 0; k<n; k++)
+  { e = mod2sparse_entry(H,k);
+    g->edge_col[k] = mod2sparse_col(e);
+    g->edge_row[k] = mod2sparse_row(e);
+  }
+
+  return g;
+}
+
+
+/* FREE SPACE OCCUPIED BY A DECODING GRAPH. */
+
+void decgraph_free
+( decgraph *g		/* Graph to free */
+)
+{
+  free(g->row_start);
+  free(g->edge_col);
+  free(g->edge_row);
+  free(g->col_start);
+  free(g->col_edge);
+  free(g);
+}
@@ -0,0 +1,60 @@
+/* DECGRAPH.H - Interface to compiled decoding graphs. */
+
+/* Copyright (c) 2014 by Allen Yu
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/* A decoding graph is a read-only copy of the structure of a parity check 
+   matrix, laid out for message passing.  Each non-zero entry of the matrix
+   is an "edge", numbered from 0 in order of rows, and by column within a 
+   row.  The edges of row i are row_start[i] to row_start[i+1]-1, and the 
+   column and row of edge k are edge_col[k] and edge_row[k].  The edges of column j, in order of row, 
+   are col_edge[col_start[j]] to col_edge[col_start[j+1]-1].  
+
+   Messages are not part of the graph.  Decoders keep them in arrays indexed 
+   by edge number, so that a pass over the checks reads them sequentially, 
+   and a pass over the bits goes through col_edge. */
+
+typedef struct
+{
+  int n_rows;		/* Number of rows (checks) */
+  int n_cols;		/* Number of columns (bits) */
+  int n_edges;		/* Number of non-zero entries */
+
+  int *row_start;	/* Index of first edge of each row, n_rows+1 long */
+  int *edge_col;	/* Column of each edge, n_edges long */
+  int *edge_row;	/* Row of each edge, n_edges long */
+
+  int *col_start;	/* Index into col_edge for each column, n_cols+1 long */
+  int *col_edge;	/* Edges of each column, n_edges long */
+
+} decgraph;
+
+
+/* MACROS. */
+
+#define decgraph_rows(g) ((g)->n_rows)    /* Get the number of rows, columns, */
+#define decgraph_cols(g) ((g)->n_cols)    /* or edges in a graph              */
+#define decgraph_edges(g) ((g)->n_edges)
+
+
+/* PROCEDURES. */
+
+decgraph *decgraph_build (mod2sparse *);
+void decgraph_free       (decgraph *);
@@ -37,6 +37,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <pthread.h>
 
 #include "rand.h"
 #include "alloc.h"
@@ -48,10 +49,53 @@
 #include "channel.h"
 #include "rcode.h"
 #include "check.h"
+#include "decgraph.h"
 #include "dec.h"
 
 
+/* GROUPS OF BLOCKS.  Blocks are read, decoded, and written in groups of one
+   block, or of Dec_batch blocks when decoding in batches.  When several
+   threads are used, groups are kept in a ring of slots, which the main thread
+   fills with blocks read and empties by writing decoded blocks in their 
+   original order, while worker threads decode the groups in between. */
+
+typedef struct
+{ long first;		/* Number of the first block in the group, from zero */
+  int nb;		/* Number of blocks in the group */
+  double *lratio;	/* Likelihood ratios for bits of each block */
+  char *dblk;		/* Decoding of each block */
+  char *pchk;		/* Parity checks for each block */
+  double *bitpr;	/* Bit probabilities for each block */
+  unsigned *iters;	/* Iterations done for each block (unsigned because
+			   can be huge for enum) */
+  int *valid;		/* Whether each decoding is a code word */
+  double *chngd;	/* Bits changed in each block (double because can be
+			   fraction if lratio==1) */
+  char *flipped;	/* Whether each block was decoded by bit flipping */
+  int done;		/* Has the group been decoded? */
+} group;
+
+static int batch;	/* Decode in batches? */
+static int text_out;	/* Write decoded blocks as characters? */
+static int packed_in;	/* Are received blocks packed? */
+static char *rbits;	/* Received block, when packed */
+static int flip;	/* Try bit flipping first? */
+static int nbatch;	/* Maximum number of blocks in a group */
+
+static group *slots;	/* Ring of groups being decoded */
+static int n_slots;	/* Number of slots in the ring */
+static long n_posted;	/* Number of groups read and made available */
+static long n_taken;	/* Number of groups taken by worker threads */
+static int all_posted;	/* Have all groups been read? */
+
+static pthread_mutex_t slot_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t slot_posted = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t slot_done = PTHREAD_COND_INITIALIZER;
+
 void usage(void);
+static int read_block (FILE *, int *, double *, double *);
+static void decode_group (group *);
+static void *worker (void *);
 
 
 /* MAIN PROGRAM. */
@@ -65,22 +109,23 @@ int main
   char **meth;
   FILE *rf, *df, *pf;
 
-  char *dblk, *pchk;
-  double *lratio;
-  double *bitpr;
-
   double *awn_data;		/* Places to store channel data */
   int *bsc_data;
 
-  unsigned iters;		/* Unsigned because can be huge for enum */
+  int n_threads;		/* Number of threads decoding blocks */
+  pthread_t *threads;
+  long n_written;		/* Number of groups written */
+  long n_read;			/* Number of blocks read */
+  int at_eof;
+  group *g;
+
   double tot_iter;		/* Double because can be huge for enum */
-  double chngd, tot_changed;	/* Double because can be fraction if lratio==1*/
+  double tot_changed;		/* Double because can be fraction if lratio==1*/
 
-  int tot_valid;
+  long tot_valid;
   char junk;
-  int valid;
 
-  int i, j, k;
+  int b, j, k;
 
   /* Look at arguments up to the decoding method specification. */
 
@@ -95,6 +140,39 @@ int main
     argc -= 1;
     argv += 1;
   }
+  batch = 0;
+  if (argc>1 && strcmp(argv[1],"-b")==0)
+  { batch = 1;
+    argc -= 1;
+    argv += 1;
+  }
+  flip = 0;
+  if (argc>1 && strcmp(argv[1],"-f")==0)
+  { flip = 1;
+    argc -= 1;
+    argv += 1;
+  }
+  text_out = 0;
+  if (argc>1 && strcmp(argv[1],"-a")==0)
+  { text_out = 1;
+    argc -= 1;
+    argv += 1;
+  }
+  osd_order = -1;
+  if (argc>3 && strcmp(argv[1],"-o")==0)
+  { if (sscanf(argv[2],"%d%c",&osd_order,&junk)!=1 || osd_order<0 
+     || osd_order>2 || sscanf(argv[3],"%lf%c",&osd_budget,&junk)!=1) 
+    { usage();
+    }
+    argc -= 3;
+    argv += 3;
+  }
+  n_threads = 1;
+  if (argc>2 && strcmp(argv[1],"-j")==0)
+  { if (sscanf(argv[2],"%d%c",&n_threads,&junk)!=1 || n_threads<1) usage();
+    argc -= 2;
+    argv += 2;
+  }
 
   if (!(pchk_file = argv[1])
    || !(rfile = argv[2])
@@ -127,6 +205,45 @@ int main
     { usage();
     }
   }
+  else if (strcmp(meth[0],"layered")==0)
+  { dec_method = Layered;
+    if (!meth[1] || sscanf(meth[1],"%d%c",&max_iter,&junk)!=1 || meth[2]) 
+    { usage();
+    }
+  }
+  else if (strcmp(meth[0],"minsum")==0)
+  { dec_method = Minsum;
+    if (!meth[1] || sscanf(meth[1],"%d%c",&max_iter,&junk)!=1 
+     || !meth[2] || sscanf(meth[2],"%lf%c",&ms_corr,&junk)!=1 || meth[3]) 
+    { usage();
+    }
+    if (ms_corr<=0 || ms_corr>1)
+    { fprintf(stderr,"Scale factor for minsum must be in (0,1]\n");
+      exit(1);
+    }
+  }
+  else if (strcmp(meth[0],"minsum-q8")==0)
+  { dec_method = Minsum_q8;
+    if (!meth[1] || sscanf(meth[1],"%d%c",&max_iter,&junk)!=1 
+     || !meth[2] || sscanf(meth[2],"%lf%c",&ms_corr,&junk)!=1 || meth[3]) 
+    { usage();
+    }
+    if (ms_corr<=0 || ms_corr>1)
+    { fprintf(stderr,"Scale factor for minsum-q8 must be in (0,1]\n");
+      exit(1);
+    }
+  }
+  else if (strcmp(meth[0],"minsum-offset")==0)
+  { dec_method = Minsum_offset;
+    if (!meth[1] || sscanf(meth[1],"%d%c",&max_iter,&junk)!=1 
+     || !meth[2] || sscanf(meth[2],"%lf%c",&ms_corr,&junk)!=1 || meth[3]) 
+    { usage();
+    }
+    if (ms_corr<0)
+    { fprintf(stderr,"Offset for minsum-offset must not be negative\n");
+      exit(1);
+    }
+  }
   else if (strcmp(meth[0],"enum-block")==0)
   { dec_method = Enum_block;
     if (!(gen_file = meth[1]) || meth[2]) usage();
@@ -139,6 +256,34 @@ int main
   { usage();
   }
 
+  if (batch && dec_method!=Minsum && dec_method!=Minsum_offset 
+            && dec_method!=Minsum_q8)
+  { fprintf(stderr,
+      "Only minsum, minsum-offset, and minsum-q8 can decode in batches\n");
+    exit(1);
+  }
+  if (batch && table==2)
+  { fprintf(stderr,"Can't produce a detailed trace when decoding in batches\n");
+    exit(1);
+  }
+  if (flip && (batch || table==2))
+  { fprintf(stderr,"Can't try bit flipping first with -b or -T\n");
+    exit(1);
+  }
+  if (n_threads>1 && table==2)
+  { fprintf(stderr,"Can't produce a detailed trace when using several threads\n");
+    exit(1);
+  }
+
+  /* Exhaustive enumeration divides the work for each block among the 
+     threads, rather than decoding several blocks at once. */
+
+  enum_threads = 1;
+  if (dec_method==Enum_block || dec_method==Enum_bit)
+  { enum_threads = n_threads;
+    n_threads = 1;
+  }
+
   /* Check that we aren't overusing standard input or output. */
 
   if ((strcmp(pchk_file,"-")==0) 
@@ -156,6 +301,7 @@ int main
   /* Read parity check file. */
 
   read_pchk(pchk_file);
+  check_setup(H);
 
   if (N<=M)
   { fprintf(stderr,
@@ -171,6 +317,15 @@ int main
     exit(1);
   }
 
+  packed_in = blockio_read_header(rf,N);
+  if (packed_in && channel!=BSC)
+  { fprintf(stderr,"Packed blocks of received data can be used only with bsc\n");
+    exit(1);
+  }
+  if (packed_in)
+  { rbits = chk_alloc (N, sizeof *rbits);
+  }
+
   /* Create file for decoded data. */
 
   df = open_file_std(dfile,"w");
@@ -179,6 +334,10 @@ int main
     exit(1);
   }
 
+  if (!text_out)
+  { blockio_write_header(df,N);
+  }
+
   /* Create file for bit probabilities, if specified. */
 
   if (pfile)
@@ -207,10 +366,22 @@ int main
 
   /* Allocate other space. */
 
-  dblk   = chk_alloc (N, sizeof *dblk);
-  lratio = chk_alloc (N, sizeof *lratio);
-  pchk   = chk_alloc (M, sizeof *pchk);
-  bitpr  = chk_alloc (N, sizeof *bitpr);
+  nbatch = batch ? Dec_batch : flip ? Bf_batch : 1;
+  n_slots = n_threads>1 ? 4*n_threads : 1;
+
+  slots = chk_alloc (n_slots, sizeof *slots);
+
+  for (k = 0; k<n_slots; k++)
+  { g = &slots[k];
+    g->lratio = chk_alloc (nbatch*N, sizeof *g->lratio);
+    g->dblk   = chk_alloc (nbatch*N, sizeof *g->dblk);
+    g->pchk   = chk_alloc (nbatch*M, sizeof *g->pchk);
+    g->bitpr  = chk_alloc (nbatch*N, sizeof *g->bitpr);
+    g->iters  = chk_alloc (nbatch, sizeof *g->iters);
+    g->valid  = chk_alloc (nbatch, sizeof *g->valid);
+    g->chngd  = chk_alloc (nbatch, sizeof *g->chngd);
+    g->flipped = chk_alloc (nbatch, sizeof *g->flipped);
+  }
 
   /* Print header for summary table. */
 
@@ -225,6 +396,19 @@ int main
     { prprp_decode_setup();
       break;
     }
+    case Layered:
+    { layered_decode_setup();
+      break;
+    }
+    case Minsum: case Minsum_offset:
+    { if (batch) minsum_decode_batch_setup();
+      else minsum_decode_setup();
+      break;
+    }
+    case Minsum_q8:
+    { minsum_q8_decode_setup();
+      break;
+    }
     case Enum_block: case Enum_bit:
     { enum_decode_setup();
       break;
@@ -232,127 +416,153 @@ int main
     default: abort();
   }
 
-  /* Read received blocks, decode, and write decoded blocks. */
+  if (flip)
+  { bitflip_decode_batch_setup();
+  }
+
+  if (osd_order>=0)
+  { osd_setup();
+  }
+
+  /* Start worker threads, if more than one thread is to be used. */
+
+  n_posted = 0;
+  n_taken = 0;
+  all_posted = 0;
+
+  if (n_threads>1)
+  { threads = chk_alloc (n_threads, sizeof *threads);
+    for (k = 0; k<n_threads; k++)
+    { if (pthread_create(&threads[k],NULL,worker,NULL)!=0)
+      { fprintf(stderr,"Can't create decoding thread\n");
+        exit(1);
+      }
+    }
+  }
+
+  /* Read received blocks, decode, and write decoded blocks.  Groups are
+     read until the ring of slots is full, and then the oldest group is 
+     written once it has been decoded.  With only one thread, a group is 
+     decoded as soon as it is read. */
 
   tot_iter = 0;
   tot_valid = 0;
   tot_changed = 0;
 
-  for (block_no = 0; ; block_no++)
+  n_read = 0;
+  n_written = 0;
+  at_eof = 0;
+
+  for (;;)
   { 
-    /* Read block from received file, exit if end-of-file encountered. */
+    /* Read groups of blocks from received file into free slots, stopping
+       if end-of-file encountered. */
 
-    for (i = 0; i<N; i++)
-    { int c;
-      switch (channel)
-      { case BSC:  
-        { c = fscanf(rf,"%1d",&bsc_data[i]); 
-          break;
-        }
-        case AWGN: case AWLN:
-        { c = fscanf(rf,"%lf",&awn_data[i]); 
+    while (!at_eof && n_posted-n_written<n_slots)
+    { 
+      g = &slots[n_posted%n_slots];
+
+      for (g->nb = 0; g->nb<nbatch; g->nb++)
+      { if (!read_block(rf,bsc_data,awn_data,g->lratio+g->nb*N)) 
+        { at_eof = 1;
           break;
         }
-        default: abort();
-      }
-      if (c==EOF) 
-      { if (i>0)
-        { fprintf(stderr,
-          "Warning: Short block (%d long) at end of received file ignored\n",i);
-        }
-        goto done;
       }
-      if (c<1 || channel==BSC && bsc_data[i]!=0 && bsc_data[i]!=1)
-      { fprintf(stderr,"File of received data is garbled\n");
-        exit(1);
-      }
-    }
 
-    /* Find likelihood ratio for each bit. */
+      if (g->nb==0) break;
 
-    switch (channel)
-    { case BSC:
-      { for (i = 0; i<N; i++)
-        { lratio[i] = bsc_data[i]==1 ? (1-error_prob) / error_prob
-                                     : error_prob / (1-error_prob);
-        }
-        break;
-      }
-      case AWGN:
-      { for (i = 0; i<N; i++)
-        { lratio[i] = exp(2*awn_data[i]/(std_dev*std_dev));
-        }
-        break;
+      g->first = n_read;
+      g->done = 0;
+      n_read += g->nb;
+
+      if (n_threads>1)
+      { pthread_mutex_lock(&slot_lock);
+        n_posted += 1;
+        pthread_cond_signal(&slot_posted);
+        pthread_mutex_unlock(&slot_lock);
       }
-      case AWLN:
-      { for (i = 0; i<N; i++)
-        { double e, d1, d0;
-          e = exp(-(awn_data[i]-1)/lwidth);
-          d1 = 1 / ((1+e)*(1+1/e));
-          e = exp(-(awn_data[i]+1)/lwidth);
-          d0 = 1 / ((1+e)*(1+1/e));
-          lratio[i] = d1/d0;
-        }
-        break;
+      else
+      { decode_group(g);
+        n_posted += 1;
       }
-      default: abort();
     }
 
-    /* Try to decode using the specified method. */
+    if (n_written==n_posted) break;
 
-    switch (dec_method)
-    { case Prprp:
-      { iters = prprp_decode (H, lratio, dblk, pchk, bitpr);
-        break;
-      }
-      case Enum_block: case Enum_bit:
-      { iters = enum_decode (lratio, dblk, bitpr, dec_method==Enum_block);
-        break;
+    /* Wait for the oldest group to be decoded. */
+
+    g = &slots[n_written%n_slots];
+
+    if (n_threads>1)
+    { pthread_mutex_lock(&slot_lock);
+      while (!g->done)
+      { pthread_cond_wait(&slot_done,&slot_lock);
       }
-      default: abort();
+      pthread_mutex_unlock(&slot_lock);
     }
 
-    /* See if it worked, and how many bits were changed. */
+    for (b = 0; b<g->nb; b++)
+    { 
+      tot_iter += g->iters[b];
+      tot_valid += g->valid[b];
+      tot_changed += g->chngd[b];
 
-    valid = check(H,dblk,pchk)==0;
+      /* Print summary table entry. */
 
-    chngd = changed(lratio,dblk,N);
+      if (table==1)
+      { printf ("%7ld %10f    %d  %8.1f\n",
+          g->first+b, (double)g->iters[b], g->valid[b], (double)g->chngd[b]);
+          /* iters is printed as a double to avoid problems if it's >= 2^31 */
+        fflush(stdout);
+      }
 
-    tot_iter += iters;
-    tot_valid += valid;
-    tot_changed += chngd;
+      /* Write decoded block. */
 
-    /* Print summary table entry. */
+      if (text_out) 
+      { blockio_write_nocrc(df,g->dblk+b*N,N);
+      }
+      else
+      { blockio_write_packed(df,g->dblk+b*N,N);
+      }
 
-    if (table==1)
-    { printf ("%7d %10f    %d  %8.1f\n",
-        block_no, (double)iters, valid, (double)chngd);
-        /* iters is printed as a double to avoid problems if it's >= 2^31 */
-      fflush(stdout);
-    }
+      /* Write bit probabilities, if asked to. */
 
-    /* Write decoded block. */
+      if (pfile)
+      { for (j = 0; j<N; j++)
+        { fprintf(pf," %.5f",g->bitpr[b*N+j]);
+        }
+        fprintf(pf,"\n");
+      }
+    }
 
-    blockio_write_nocrc(df,dblk,N);
+    n_written += 1;
+  }
 
-    /* Write bit probabilities, if asked to. */
+  /* Stop the worker threads. */
 
-    if (pfile)
-    { for (j = 0; j<N; j++)
-      { fprintf(pf," %.5f",bitpr[j]);
-      }
-      fprintf(pf,"\n");
+  if (n_threads>1)
+  { pthread_mutex_lock(&slot_lock);
+    all_posted = 1;
+    pthread_cond_broadcast(&slot_posted);
+    pthread_mutex_unlock(&slot_lock);
+    for (k = 0; k<n_threads; k++)
+    { pthread_join(threads[k],NULL);
     }
   }
 
+  block_no = n_read;
+
   /* Finish up. */
 
-done: 
   fprintf(stderr,
-  "Correctly decoded %d blocks, %d valid.  Average %.1f iterations, %.0f%% bit changes found\n",
+  "Correctly decoded %ld blocks, %ld valid.  Average %.1f iterations, %.0f%% bit changes found\n",
    block_no, tot_valid, (double)tot_iter/block_no, 
    100.0*(double)tot_changed/(N*block_no));
 
+  if (!text_out)
+  { blockio_write_count(df,n_read);
+  }
+
   if (ferror(df) || fclose(df)!=0)
   { fprintf(stderr,"Error writing decoded blocks to %s\n",dfile);
     exit(1);
@@ -375,9 +585,243 @@ done:
 void usage(void)
 { fprintf(stderr,"Usage:\n");
   fprintf(stderr,
-"  decode [ -t ] pchk-file received-file decoded-file [ bp-file ] channel method\n");
+"  decode [ -t | -T ] [ -b | -f ] [ -a ] [ -o order seconds ] [ -j threads ]\n\
+         pchk-file received-file decoded-file [ bp-file ] channel method\n");
   channel_usage();
   fprintf(stderr,
 "Method:  enum-block gen-file | enum-bit gen-file | prprp [-]max-iterations\n");
+  fprintf(stderr,
+"         layered [-]max-iterations | minsum-q8 [-]max-iterations scale\n");
+  fprintf(stderr,
+"         minsum [-]max-iterations scale | minsum-offset [-]max-iterations offset\n");
+  fprintf(stderr,
+"-b decodes blocks %d at a time (minsum methods only), in single precision,\n\
+   or with 8-bit messages for minsum-q8\n",
+   Dec_batch);
+  fprintf(stderr,
+"-f tries bit flipping on %d blocks at a time, using the method for those not fixed\n",
+   Bf_batch);
+  fprintf(stderr,
+"-a writes decoded blocks as '0' and '1' characters, rather than packed\n");
+  fprintf(stderr,
+"-o does ordered statistics decoding of the given order (0, 1, or 2) for blocks\n\
+   not decoded, taking at most about the given time for each\n");
+  fprintf(stderr,
+"-j decodes blocks in parallel with the given number of threads (for enum\n\
+   methods, the codewords for each block are divided among the threads)\n");
   exit(1);
 }
+
+
+/* DECODE A GROUP OF BLOCKS.  Decodes each block of the group with the 
+   specified method, and finds whether it worked, and how many bits were
+   changed.  This is done in a worker thread when more than one thread is
+   used, which is not allowed when a detailed trace is being produced, so
+   the block_no global is then used only by one thread. */
+
+static void decode_group
+( group *g		/* Group to decode */
+)
+{
+  double *lr, *bp;
+  char *db, *pc;
+  int b, j;
+
+  if (batch && dec_method==Minsum_q8)
+  { minsum_q8_decode_batch (H, g->nb, g->lratio, g->dblk, g->pchk, g->bitpr, 
+                            g->iters);
+  }
+  else if (batch)
+  { minsum_decode_batch (H, g->nb, g->lratio, g->dblk, g->pchk, g->bitpr, 
+                         g->iters);
+  }
+
+  for (b = 0; b<g->nb; b++) 
+  { g->flipped[b] = 0;
+  }
+
+  if (flip)
+  { bitflip_decode_batch (H, g->nb, g->lratio, g->dblk, g->flipped, g->iters);
+  }
+
+  for (b = 0; b<g->nb; b++)
+  { 
+    lr = g->lratio + b*N;
+    bp = g->bitpr + b*N;
+    db = g->dblk + b*N;
+    pc = g->pchk + b*M;
+
+    if (table==2) block_no = g->first + b;
+
+    /* Try to decode using the specified method, unless already done.  The
+       bit probabilities for a block decoded by bit flipping are just its
+       decoding. */
+
+    if (g->flipped[b])
+    { for (j = 0; j<N; j++) 
+      { bp[j] = db[j];
+      }
+    }
+    else if (!batch)
+    { switch (dec_method)
+      { case Prprp:
+        { g->iters[b] = prprp_decode (H, lr, db, pc, bp);
+          break;
+        }
+        case Layered:
+        { g->iters[b] = layered_decode (H, lr, db, pc, bp);
+          break;
+        }
+        case Minsum: case Minsum_offset:
+        { g->iters[b] = minsum_decode (H, lr, db, pc, bp);
+          break;
+        }
+        case Minsum_q8:
+        { g->iters[b] = minsum_q8_decode (H, lr, db, pc, bp);
+          break;
+        }
+        case Enum_block: case Enum_bit:
+        { g->iters[b] = enum_decode (lr, db, bp, dec_method==Enum_block);
+          break;
+        }
+        default: abort();
+      }
+    }
+
+    /* See if it worked, and how many bits were changed. */
+
+    g->valid[b] = check(H,db,pc)==0;
+
+    /* Try ordered statistics decoding if no codeword was found. */
+
+    if (!g->valid[b] && osd_order>=0)
+    { osd_decode (H, lr, bp, db);
+      g->valid[b] = check(H,db,pc)==0;
+    }
+
+    g->chngd[b] = changed(lr,db,N);
+  }
+}
+
+
+/* DECODE GROUPS IN A WORKER THREAD.  Takes groups from the ring of slots in
+   the order they were read, until all have been taken. */
+
+static void *worker
+( void *arg
+)
+{
+  group *g;
+
+  pthread_mutex_lock(&slot_lock);
+
+  for (;;)
+  { 
+    while (n_taken==n_posted && !all_posted)
+    { pthread_cond_wait(&slot_posted,&slot_lock);
+    }
+
+    if (n_taken==n_posted) break;
+
+    g = &slots[n_taken%n_slots];
+    n_taken += 1;
+
+    pthread_mutex_unlock(&slot_lock);
+
+    decode_group(g);
+
+    pthread_mutex_lock(&slot_lock);
+
+    g->done = 1;
+    pthread_cond_broadcast(&slot_done);
+  }
+
+  pthread_mutex_unlock(&slot_lock);
+
+  return 0;
+}
+
+
+/* READ A RECEIVED BLOCK AND FIND LIKELIHOOD RATIOS.  Returns 1 if a block
+   was read, and 0 if end-of-file was encountered instead.  Data for the 
+   channel in use is stored in bsc_data or awn_data, and the likelihood 
+   ratio for each bit in lratio. */
+
+static int read_block
+( FILE *rf,		/* File of received data */
+  int *bsc_data,	/* Places to store channel data */
+  double *awn_data,
+  double *lratio	/* Place to store likelihood ratios */
+)
+{
+  int i;
+
+  /* Read block from received file. */
+
+  if (packed_in)
+  { if (blockio_read_packed(rf,rbits,N)==EOF)
+    { return 0;
+    }
+    for (i = 0; i<N; i++)
+    { bsc_data[i] = rbits[i];
+    }
+  }
+
+  else for (i = 0; i<N; i++)
+  { int c;
+    switch (channel)
+    { case BSC:  
+      { c = fscanf(rf,"%1d",&bsc_data[i]); 
+        break;
+      }
+      case AWGN: case AWLN:
+      { c = fscanf(rf,"%lf",&awn_data[i]); 
+        break;
+      }
+      default: abort();
+    }
+    if (c==EOF) 
+    { if (i>0)
+      { fprintf(stderr,
+        "Warning: Short block (%d long) at end of received file ignored\n",i);
+      }
+      return 0;
+    }
+    if (c<1 || channel==BSC && bsc_data[i]!=0 && bsc_data[i]!=1)
+    { fprintf(stderr,"File of received data is garbled\n");
+      exit(1);
+    }
+  }
+
+  /* Find likelihood ratio for each bit. */
+
+  switch (channel)
+  { case BSC:
+    { for (i = 0; i<N; i++)
+      { lratio[i] = bsc_data[i]==1 ? (1-error_prob) / error_prob
+                                   : error_prob / (1-error_prob);
+      }
+      break;
+    }
+    case AWGN:
+    { for (i = 0; i<N; i++)
+      { lratio[i] = exp(2*awn_data[i]/(std_dev*std_dev));
+      }
+      break;
+    }
+    case AWLN:
+    { for (i = 0; i<N; i++)
+      { double e, d1, d0;
+        e = exp(-(awn_data[i]-1)/lwidth);
+        d1 = 1 / ((1+e)*(1+1/e));
+        e = exp(-(awn_data[i]+1)/lwidth);
+        d0 = 1 / ((1+e)*(1+1/e));
+        lratio[i] = d1/d0;
+      }
+      break;
+    }
+    default: abort();
+  }
+
+  return 1;
+}
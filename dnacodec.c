@@ -0,0 +1,675 @@
+/* DNACODEC.C - Encode a file as DNA, or decode it back, in one process. */
+
+/* Copyright (c) 2014 by Allen Yu
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+ * PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *  */
+
+/* The encode command does the work of scripts/run_encode.sh, which pipes
+   the file through lzma, encode, and DNAIO -f, and the decode command does
+   the work of scripts/run_decode.sh, which pipes it through DNAIO -c, decode,
+   extract, and lzma -d.  Here the stages pass blocks of bits to each other
+   in memory, and the parity check and generator matrices are read once.
+   Data is streamed through, so memory use doesn't grow with file size.
+   The FASTA file written is the same as the pipeline writes, and is read in
+   the same way.  Compression can be turned off with -n, if the file is
+   already compressed. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <lzma.h>
+
+#include "alloc.h"
+#include "open.h"
+#include "mod2sparse.h"
+#include "mod2dense.h"
+#include "mod2convert.h"
+#include "rcode.h"
+#include "enc.h"
+#include "check.h"
+#include "decgraph.h"
+#include "dec.h"
+#include "bitpack.h"
+#include "crc.h"
+#include "int2bin.h"
+#include "bin2dec.h"
+#include "str_match.h"
+#include "version.h"
+
+#define Lzma_preset 9		/* Compression level, as for lzma -9 */
+
+#define Default_error_prob 0.09	/* Error probability assumed for bits read */
+#define Default_max_iter 100	/* Iterations of probability propagation */
+
+#define Max_pos_bits 62		/* Longest position tried when decoding */
+
+#define Io_bufsize 65536	/* Size of buffers for lzma */
+
+void usage(void);
+
+static void encode_file (char *, char *, int);
+static void decode_file (char *, char *, int, double);
+
+static size_t get_data (FILE *, lzma_stream *, unsigned char *, size_t, int *);
+static void put_data (FILE *, lzma_stream *, unsigned char *, size_t, int);
+static int put_dna (char *, char *, int);
+
+
+/* MAIN PROGRAM. */
+
+int main
+( int argc,
+  char **argv
+)
+{
+  char *pchk_file, *gen_file, *in_file, *out_file;
+  int compress, decoding;
+  double error_prob;
+  char junk;
+
+  /* Look at arguments. */
+
+  if (argc<2) usage();
+
+  if (strcmp(argv[1],"encode")==0)
+  { decoding = 0;
+  }
+  else if (strcmp(argv[1],"decode")==0)
+  { decoding = 1;
+  }
+  else
+  { usage();
+  }
+
+  argc -= 1;
+  argv += 1;
+
+  compress = 1;
+  if (argc>1 && strcmp(argv[1],"-n")==0)
+  { compress = 0;
+    argc -= 1;
+    argv += 1;
+  }
+
+  error_prob = Default_error_prob;
+  max_iter = Default_max_iter;
+
+  if (decoding && argc>2 && strcmp(argv[1],"-e")==0)
+  { if (sscanf(argv[2],"%lf%c",&error_prob,&junk)!=1
+     || error_prob<=0 || error_prob>=1)
+    { usage();
+    }
+    argc -= 2;
+    argv += 2;
+  }
+
+  if (decoding && argc>2 && strcmp(argv[1],"-i")==0)
+  { if (sscanf(argv[2],"%d%c",&max_iter,&junk)!=1 || max_iter==0) usage();
+    argc -= 2;
+    argv += 2;
+  }
+
+  if (!(pchk_file = argv[1])
+   || !(gen_file = argv[2])
+   || !(in_file = argv[3])
+   || !(out_file = argv[4])
+   || argv[5])
+  { usage();
+  }
+
+  if ((strcmp(pchk_file,"-")==0)
+    + (strcmp(gen_file,"-")==0)
+    + (strcmp(in_file,"-")==0) > 1)
+  { fprintf(stderr,"Can't read more than one stream from standard input\n");
+    exit(1);
+  }
+
+  /* Read the parity check and generator matrices. */
+
+  read_pchk(pchk_file);
+  check_setup(H);
+
+  if (N<=M)
+  { fprintf(stderr,
+ "Number of bits (%d) should be greater than number of checks (%d)\n",N,M);
+    exit(1);
+  }
+
+  if ((N-M)%8!=0)
+  { fprintf(stderr,
+      "Number of message bits (%d) must be a multiple of eight\n",N-M);
+    exit(1);
+  }
+
+  read_gen(gen_file,decoding,0);
+
+  if (decoding)
+  { decode_file (in_file, out_file, compress, error_prob);
+  }
+  else
+  { encode_file (in_file, out_file, compress);
+  }
+
+  return 0;
+}
+
+
+/* ENCODE A FILE.  The file is compressed, if asked for, and split into
+   blocks of N-M bits, with the last block padded with the terminator
+   sequence (so there is always a last block with some padding).  The blocks
+   are encoded in batches, and each is written as a FASTA record, with its
+   position, checksums, and version tags.  Only one batch of blocks is held
+   in memory, however large the file. */
+
+static void encode_file
+( char *source_file,	/* File to encode */
+  char *fasta_file,	/* File to write DNA sequences to */
+  int compress		/* Compress the file first? */
+)
+{
+  lzma_options_lzma opt;
+  lzma_stream strm = LZMA_STREAM_INIT;
+
+  unsigned char *data, *packed;
+  size_t n_data;
+  long n, n_blocks, n_verified;
+  int last, last_pos, bytes, term_len, at_end;
+
+  char *sblk, *cblk, *chks, *line;
+  char pos[80], hcrc[80], dcrc[80];
+  int nb, b, i, k, l;
+  crc_t crc;
+  FILE *srcf, *f;
+
+  srcf = open_file_std(source_file,"rb");
+  if (srcf==NULL)
+  { fprintf(stderr,"Can't open source file: %s\n",source_file);
+    exit(1);
+  }
+
+  if (compress)
+  { if (lzma_lzma_preset(&opt,Lzma_preset)
+     || lzma_alone_encoder(&strm,&opt)!=LZMA_OK)
+    { fprintf(stderr,"Can't set up lzma compression\n");
+      exit(1);
+    }
+  }
+
+  f = open_file_std(fasta_file,"w");
+  if (f==NULL)
+  { fprintf(stderr,"Can't create file for DNA sequences: %s\n",fasta_file);
+    exit(1);
+  }
+
+  bytes = (N-M)/8;
+  term_len = strlen(version_terminator);
+
+  batch_encode_setup();
+
+  data = chk_alloc (bytes*Enc_batch, 1);
+  sblk = chk_alloc ((N-M)*Enc_batch, sizeof *sblk);
+  cblk = chk_alloc (N*Enc_batch, sizeof *cblk);
+  chks = chk_alloc (M, sizeof *chks);
+  line = chk_alloc (N+1024, sizeof *line);
+  packed = chk_alloc ((N+7)/8, 1);
+
+  n_verified = 0;
+  last_pos = 0;
+  at_end = 0;
+
+  for (n = 0; ; n += nb)
+  {
+    /* Get the data for a batch of blocks.  If there isn't enough to fill
+       the batch, this is the last, ending with a block that is padded. */
+
+    n_data = get_data (srcf, compress ? &strm : 0, data, bytes*Enc_batch,
+                       &at_end);
+
+    last = n_data < (size_t) bytes*Enc_batch;
+    nb = last ? n_data/bytes + 1 : Enc_batch;
+    if (last) last_pos = (n_data%bytes)*8;
+
+    /* Unpack the bits, high-order bit first, and pad the last block. */
+
+    bitpack_unpack (data, sblk, n_data*8);
+
+    if (last)
+    { for (i = n_data*8; i<nb*(N-M); i++)
+      { k = i - n_data*8;
+        sblk[i] = version_terminator[k%term_len]=='1';
+      }
+    }
+
+    batch_encode (nb, sblk, cblk);
+
+    for (b = 0; b<nb; b++)
+    {
+      if (encode_verified (n+b, Enc_verify_default))
+      { if (check (H, cblk+b*N, chks)!=0)
+        { fprintf(stderr,"Output block %ld is not a code word!\n",n+b);
+          abort();
+        }
+        n_verified += 1;
+      }
+
+      /* Find the position and checksums. */
+
+      int2bin_evenpad(n+b,pos);
+      crc = crc_init();
+      crc = crc_update(crc, (unsigned char *)pos, strlen(pos));
+      crc = crc_finalize(crc);
+      int2bin(crc,hcrc);
+
+      (void) bitpack_pack (cblk+b*N, packed, N);
+      crc = crc_init();
+      crc = crc_update(crc, packed, N/8);
+      crc = crc_finalize(crc);
+      int2bin(crc,dcrc);
+
+      /* Write the FASTA record. */
+
+      l = 0;
+      line[l++] = '>';
+      l += put_dna (line+l, pos, strlen(pos));
+      line[l++] = '\n';
+      l += put_dna (line+l, version_5prime, strlen(version_5prime));
+      l += put_dna (line+l, pos, strlen(pos));
+      l += put_dna (line+l, hcrc, strlen(hcrc));
+      for (i = 0; i+1<N; i += 2)
+      { line[l++] = "ATCG"[2*cblk[b*N+i]+cblk[b*N+i+1]];
+      }
+      l += put_dna (line+l, dcrc, strlen(dcrc));
+      l += put_dna (line+l, version_3prime, strlen(version_3prime));
+      line[l++] = '\n';
+
+      fwrite (line, 1, l, f);
+    }
+
+    if (last) break;
+  }
+
+  n_blocks = n + nb;
+
+  if (ferror(f) || fclose(f)!=0)
+  { fprintf(stderr,"Error writing DNA sequences to %s\n",fasta_file);
+    exit(1);
+  }
+
+  fclose(srcf);
+  if (compress) lzma_end(&strm);
+
+  fprintf(stderr,
+    "Encoded %ld blocks, source block size %d, encoded block size %d\n",
+    n_blocks, N-M, N);
+  fprintf(stderr,
+    "Position %d to %d of the last block was padded with double terminator\n",
+    last_pos, N-M);
+  fprintf(stderr,"Verified %ld of %ld blocks to be code words\n",
+    n_verified, n_blocks);
+}
+
+
+/* DECODE A FILE.  Each FASTA record has its version tags checked and
+   removed, its position found by matching the header checksum, and its
+   block decoded by probability propagation, for a binary symmetric channel.
+   The message bits of the blocks, in the order read, are put together,
+   with the terminator padding trimmed from the last block, and the result
+   is decompressed, if it was compressed.  Data is passed on as each block
+   is decoded, holding back only the block before, which may be the last. */
+
+static void decode_file
+( char *fasta_file,	/* File of DNA sequences to decode */
+  char *out_file,	/* File to write decoded data to */
+  int compress,		/* Was the data compressed? */
+  double error_prob	/* Probability that a bit read is wrong */
+)
+{
+  lzma_stream strm = LZMA_STREAM_INIT;
+
+  unsigned char *data;
+  char *line, *bits, *dblk, *pchk, *msg;
+  char pos[80], hcrc[80];
+  double *lratio, *bprb;
+  int max_line, len, bytes, term_len;
+  int i, j, p, t5, t3;
+  long n_blocks, n_valid;
+  crc_t crc;
+  FILE *f, *outf;
+
+  f = open_file_std(fasta_file,"r");
+  if (f==NULL)
+  { fprintf(stderr,"Can't open file of DNA sequences: %s\n",fasta_file);
+    exit(1);
+  }
+
+  if (compress && lzma_alone_decoder(&strm,UINT64_MAX)!=LZMA_OK)
+  { fprintf(stderr,"Can't set up lzma decompression\n");
+    exit(1);
+  }
+
+  outf = open_file_std(out_file,"wb");
+  if (outf==NULL)
+  { fprintf(stderr,"Can't create file for decoded data: %s\n",out_file);
+    exit(1);
+  }
+
+  dec_method = Prprp;
+  table = 0;
+  prprp_decode_setup();
+
+  bytes = (N-M)/8;
+
+  max_line = N+1024;
+  line = chk_alloc (max_line+1, sizeof *line);
+  bits = chk_alloc (2*max_line+1, sizeof *bits);
+  lratio = chk_alloc (N, sizeof *lratio);
+  bprb = chk_alloc (N, sizeof *bprb);
+  dblk = chk_alloc (N, sizeof *dblk);
+  pchk = chk_alloc (M, sizeof *pchk);
+  msg = chk_alloc (N-M, sizeof *msg);
+  data = chk_alloc (bytes, 1);
+
+  t5 = strlen(version_5prime_DNA);
+  t3 = strlen(version_3prime_DNA);
+  term_len = strlen(version_terminator);
+
+  n_blocks = 0;
+  n_valid = 0;
+
+  for (;;)
+  {
+    /* Read the header line of a record, and then its sequence. */
+
+    if (fgets(line,max_line,f)==NULL) break;
+    if (line[0]=='\n') continue;
+    if (line[0]!='>')
+    { fprintf(stderr,"Error in fasta format\n");
+      exit(1);
+    }
+    if (fgets(line,max_line,f)==NULL)
+    { fprintf(stderr,"Error in fasta format\n");
+      exit(1);
+    }
+
+    len = strlen(line);
+    while (len>0 && (line[len-1]=='\n' || line[len-1]=='\r')) len -= 1;
+    line[len] = 0;
+
+    /* Check the version tags, allowing one error in each, and remove them. */
+
+    if (len<t5+t3)
+    { fprintf(stderr,"Sequence %ld is too short\n",n_blocks+1);
+      exit(1);
+    }
+
+    strncpy(pos,line,t5);
+    pos[t5] = 0;
+    i = ldistance(pos,version_5prime_DNA);
+    strncpy(pos,line+len-t3,t3);
+    pos[t3] = 0;
+    j = ldistance(pos,version_3prime_DNA);
+
+    if (i>1 || j>1)
+    { fprintf(stderr,"Incorrect version tags in source file! %d %d\n",i,j);
+      exit(1);
+    }
+
+    /* Convert the rest to bits, as characters. */
+
+    len -= t5+t3;
+    for (i = 0; i<len; i++)
+    { switch (line[t5+i])
+      { case 'A': bits[2*i] = '0'; bits[2*i+1] = '0'; break;
+        case 'T': bits[2*i] = '0'; bits[2*i+1] = '1'; break;
+        case 'C': bits[2*i] = '1'; bits[2*i+1] = '0'; break;
+        case 'G': bits[2*i] = '1'; bits[2*i+1] = '1'; break;
+        default:
+        { fprintf(stderr,"Incorrect base %c in source file!\n",line[t5+i]);
+          exit(1);
+        }
+      }
+    }
+    len *= 2;
+    bits[len] = 0;
+
+    /* Find how long the position is from the header checksum.  Positions
+       always have an even number of bits, up to Max_pos_bits. */
+
+    for (j = 2; j<=Max_pos_bits && j+64<=len; j += 2)
+    { strncpy(pos,bits,j);
+      pos[j] = 0;
+      crc = crc_init();
+      crc = crc_update(crc, (unsigned char *)pos, j);
+      crc = crc_finalize(crc);
+      int2bin(crc,hcrc);
+      if (strncmp(bits+j,hcrc,32)==0) break;
+    }
+
+    if (j>Max_pos_bits || j+64>len)
+    { fprintf(stderr,"Can't find proper address in sequence %ld!\n",
+        n_blocks+1);
+      exit(1);
+    }
+
+    if (len-j-64!=N)
+    { fprintf(stderr,"Block %ld has %d bits, not %d!\n",
+        bin2dec(pos),len-j-64,N);
+      exit(1);
+    }
+
+    /* Pass on the data from the block before, now known not to be last. */
+
+    if (n_blocks>0)
+    { put_data (outf, compress ? &strm : 0, data, bytes, 0);
+    }
+
+    /* Decode the block, and take its message bits. */
+
+    for (i = 0; i<N; i++)
+    { lratio[i] = bits[j+32+i]=='1' ? (1-error_prob) / error_prob
+                                    : error_prob / (1-error_prob);
+    }
+
+    block_no = n_blocks;
+    (void) prprp_decode (H, lratio, dblk, pchk, bprb);
+    n_valid += check(H,dblk,pchk)==0;
+
+    for (i = M; i<N; i++)
+    { msg[i-M] = dblk[cols[i]];
+    }
+
+    (void) bitpack_pack (msg, data, N-M);
+
+    n_blocks += 1;
+  }
+
+  if (ferror(f) || fclose(f)!=0)
+  { fprintf(stderr,"Error reading DNA sequences from %s\n",fasta_file);
+    exit(1);
+  }
+
+  if (n_blocks==0)
+  { fprintf(stderr,"No blocks found in %s\n",fasta_file);
+    exit(1);
+  }
+
+  /* Trim the terminator padding from the last block.  It starts at the
+     first byte after which the rest of the block matches the start of
+     the terminator sequence. */
+
+  for (p = 0; p<N-M; p += 8)
+  { for (i = p; i<N-M; i++)
+    { if (msg[i] != (version_terminator[(i-p)%term_len]=='1')) break;
+    }
+    if (i==N-M) break;
+  }
+
+  put_data (outf, compress ? &strm : 0, data, p/8, 1);
+
+  if (ferror(outf) || fclose(outf)!=0)
+  { fprintf(stderr,"Error writing decoded data to %s\n",out_file);
+    exit(1);
+  }
+
+  if (compress) lzma_end(&strm);
+
+  fprintf(stderr,"Decoded %ld blocks, %ld valid\n",n_blocks,n_valid);
+}
+
+
+/* CONVERT BITS TO DNA.  The bits are given as '0' and '1' characters, and
+   each pair of them becomes one base.  Returns the number of bases. */
+
+static int put_dna
+( char *dna,		/* Place to store bases */
+  char *bin,		/* Bits to convert */
+  int l			/* Number of bits, which must be even */
+)
+{
+  int i;
+
+  for (i = 0; i+1<l; i += 2)
+  { dna[i/2] = "ATCG"[2*(bin[i]=='1')+(bin[i+1]=='1')];
+  }
+
+  return l/2;
+}
+
+
+/* GET DATA TO ENCODE.  Reads from the source file, compressing with lzma if
+   a stream is given, until the space given is full, or the data ends.  
+   Returns the number of bytes stored, which is less than asked for only at 
+   the end of the data. */
+
+static size_t get_data
+( FILE *f,		/* Source file */
+  lzma_stream *strm,	/* Stream set up for compression, or 0 */
+  unsigned char *buf,	/* Place to store data */
+  size_t size,		/* Number of bytes wanted */
+  int *at_end		/* Set when all data has been returned */
+)
+{
+  static unsigned char in_buf[Io_bufsize];
+  lzma_ret r;
+
+  if (*at_end) return 0;
+
+  if (strm==0)
+  { size = fread(buf,1,size,f);
+    if (ferror(f))
+    { fprintf(stderr,"Error reading source file\n");
+      exit(1);
+    }
+    return size;
+  }
+
+  strm->next_out = buf;
+  strm->avail_out = size;
+
+  while (strm->avail_out>0)
+  {
+    if (strm->avail_in==0 && !feof(f))
+    { strm->next_in = in_buf;
+      strm->avail_in = fread(in_buf,1,Io_bufsize,f);
+      if (ferror(f))
+      { fprintf(stderr,"Error reading source file\n");
+        exit(1);
+      }
+    }
+
+    r = lzma_code(strm, feof(f) ? LZMA_FINISH : LZMA_RUN);
+
+    if (r==LZMA_STREAM_END)
+    { *at_end = 1;
+      break;
+    }
+
+    if (r!=LZMA_OK)
+    { fprintf(stderr,"Error in lzma compression (code %d)\n",(int)r);
+      exit(1);
+    }
+  }
+
+  return size - strm->avail_out;
+}
+
+
+/* PUT OUT DECODED DATA.  Writes to the output file, decompressing with lzma
+   if a stream is given.  The last call says that the data is finished. */
+
+static void put_data
+( FILE *f,		/* Output file */
+  lzma_stream *strm,	/* Stream set up for decompression, or 0 */
+  unsigned char *buf,	/* Data to put out */
+  size_t n,		/* Number of bytes of data */
+  int finish		/* Is this the end of the data? */
+)
+{
+  static unsigned char out_buf[Io_bufsize];
+  static int ended;
+  lzma_ret r;
+
+  if (strm==0)
+  { fwrite(buf,1,n,f);
+    return;
+  }
+
+  if (ended) return;
+
+  strm->next_in = buf;
+  strm->avail_in = n;
+
+  for (;;)
+  {
+    strm->next_out = out_buf;
+    strm->avail_out = Io_bufsize;
+
+    r = lzma_code(strm, finish ? LZMA_FINISH : LZMA_RUN);
+
+    fwrite(out_buf,1,Io_bufsize-strm->avail_out,f);
+
+    if (r==LZMA_STREAM_END)
+    { ended = 1;
+      return;
+    }
+
+    if (r!=LZMA_OK)
+    { fprintf(stderr,"Error in lzma data (code %d)\n",(int)r);
+      exit(1);
+    }
+
+    if (strm->avail_in==0 && strm->avail_out>0 && !finish) return;
+  }
+}
+
+
+/* PRINT USAGE MESSAGE AND EXIT. */
+
+void usage(void)
+{ fprintf(stderr,
+"Usage:  dnacodec encode [ -n ] pchk-file gen-file source-file fasta-file\n\
+        dnacodec decode [ -n ] [ -e error-prob ] [ -i max-iterations ]\n\
+                 pchk-file gen-file fasta-file decoded-file\n");
+  fprintf(stderr,
+"-n skips lzma compression (the file given to decode must match)\n\
+-e gives the probability that a bit read is wrong (default %.2f)\n\
+-i gives the iterations of probability propagation (default %d)\n",
+   Default_error_prob, Default_max_iter);
+  exit(1);
+}
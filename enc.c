@@ -15,6 +15,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <math.h>
 
 #include "rand.h"
@@ -30,51 +31,202 @@
    encoding from the global variables declared in rcode.h */
 
 
-/* ENCODE A BLOCK USING A SPARSE REPRESENTATION OF THE GENERATOR MATRIX. */
+/* PLAN FOR SPARSE ENCODING.  The columns of H for message bits and the rows
+   of L and U are copied into flat index arrays, in the order they are used,
+   and the bits being computed are kept packed 64 to a word, so that encoding
+   a block needs no allocation and no following of links.  The matrices are
+   frozen (if they aren't already), so the arrays are filled from the 
+   numbering of their entries. */
+
+static int *se_h_start, *se_h_row; /* Rows of H in each message bit's column */
+
+static int *se_l_start, *se_l_col; /* Columns of L below the diagonal, for each 
+				      row in the order they are solved */
+static int *se_l_x;		/* Bit of x that each row of L is solved for */
+static char *se_l_diag;		/* Is the diagonal in this row of L one? */
+
+static int *se_u_start, *se_u_col; /* Columns of U other than the diagonal */
+static char *se_u_diag;		/* Is the diagonal in this row of U one? */
+
+static _Thread_local uint64_t *se_x, *se_y, *se_z; /* Packed workspace */
+
+#define se_bit(v,i) ((int)((v)[(i)>>6]>>((i)&63))&1)
+#define se_put(v,i,b) ((v)[(i)>>6] |= (uint64_t)(b)<<((i)&63))
+
+#define se_row_len(m,i) (mod2sparse_row_start(m,(i)+1)-mod2sparse_row_start(m,i))
+#define se_col_len(m,j) (mod2sparse_col_start(m,(j)+1)-mod2sparse_col_start(m,j))
+
+static void se_h_setup (void)
+{
+  mod2entry *e;
+  int j, k, n;
+
+  if (se_h_start) return;
+
+  mod2sparse_freeze(H);
+
+  se_h_start = chk_alloc (N-M+1, sizeof *se_h_start);
+
+  n = 0;
+  for (j = M; j<N; j++) 
+  { n += se_col_len(H,cols[j]);
+  }
+  se_h_row = chk_alloc (n+1, sizeof *se_h_row);
+
+  n = 0;
+  for (j = M; j<N; j++)
+  { se_h_start[j-M] = n;
+    for (k = mod2sparse_col_start(H,cols[j]); 
+         k<mod2sparse_col_start(H,cols[j]+1); 
+         k++)
+    { e = mod2sparse_entry(H,mod2sparse_col_entry(H,k));
+      se_h_row[n++] = mod2sparse_row(e);
+    }
+  }
+  se_h_start[N-M] = n;
+}
+
+void sparse_encode_setup (void)
+{
+  mod2entry *e;
+  int i, k, n;
+
+  if (se_l_start) return;
+
+  /* Message bit columns of H. */
+
+  se_h_setup();
+
+  mod2sparse_freeze(L);
+  mod2sparse_freeze(U);
+
+  /* Rows of L, in the order used by forward substitution, which also checks
+     that L is lower-triangular. */
+
+  se_l_start = chk_alloc (M+1, sizeof *se_l_start);
+  se_l_x = chk_alloc (M, sizeof *se_l_x);
+  se_l_diag = chk_alloc (M, sizeof *se_l_diag);
+
+  n = 0;
+  for (i = 0; i<M; i++) 
+  { n += se_row_len(L,rows[i]);
+    e = mod2sparse_last_in_row(L,rows[i]);
+    if (!mod2sparse_at_end(e) && mod2sparse_col(e)>i)
+    { fprintf(stderr,"sparse_encode_setup: L is not lower-triangular\n");
+      exit(1);
+    }
+  }
+  se_l_col = chk_alloc (n+1, sizeof *se_l_col);
+
+  n = 0;
+  for (i = 0; i<M; i++)
+  { se_l_start[i] = n;
+    se_l_x[i] = rows[i];
+    for (k = mod2sparse_row_start(L,rows[i]); 
+         k<mod2sparse_row_start(L,rows[i]+1); 
+         k++)
+    { e = mod2sparse_entry(L,k);
+      if (mod2sparse_col(e)==i) se_l_diag[i] = 1;
+      else se_l_col[n++] = mod2sparse_col(e);
+    }
+  }
+  se_l_start[M] = n;
+
+  /* Rows of U, checking that U is upper-triangular after column reordering. */
+
+  se_u_start = chk_alloc (M+1, sizeof *se_u_start);
+  se_u_diag = chk_alloc (M, sizeof *se_u_diag);
+
+  n = 0;
+  for (i = 0; i<M; i++)
+  { n += se_row_len(U,i);
+    e = mod2sparse_last_in_col(U,cols[i]);
+    if (!mod2sparse_at_end(e) && mod2sparse_row(e)>i)
+    { fprintf(stderr,"sparse_encode_setup: U is not upper-triangular\n");
+      exit(1);
+    }
+  }
+  se_u_col = chk_alloc (n+1, sizeof *se_u_col);
+
+  n = 0;
+  for (i = 0; i<M; i++)
+  { se_u_start[i] = n;
+    for (k = mod2sparse_row_start(U,i); k<mod2sparse_row_start(U,i+1); k++)
+    { e = mod2sparse_entry(U,k);
+      if (mod2sparse_col(e)==cols[i]) se_u_diag[i] = 1;
+      else se_u_col[n++] = mod2sparse_col(e);
+    }
+  }
+  se_u_start[M] = n;
+}
+
+
+/* ENCODE A BLOCK USING A SPARSE REPRESENTATION OF THE GENERATOR MATRIX.  
+   Uses the plan made by sparse_encode_setup, which must be called first. */
 
 void sparse_encode
 ( char *sblk,
   char *cblk
 )
 {
-  int i, j;
+  int *h_start, *h_row, *l_start, *l_col, *l_x, *u_start, *u_col;
+  char *l_diag, *u_diag;
+  uint64_t *x, *y, *z;
+  int i, j, k, b, wm, wn;
+
+  wm = (M+63) / 64;
+  wn = (N+63) / 64;
+
+  if (!se_x)
+  { se_x = chk_alloc (wm, sizeof *se_x);
+    se_y = chk_alloc (wm, sizeof *se_y);
+    se_z = chk_alloc (wn, sizeof *se_z);
+  }
 
-  mod2entry *e;
-  char *x, *y;
+  h_start = se_h_start; h_row = se_h_row;
+  l_start = se_l_start; l_col = se_l_col; l_x = se_l_x; l_diag = se_l_diag;
+  u_start = se_u_start; u_col = se_u_col; u_diag = se_u_diag;
+  x = se_x; y = se_y; z = se_z;
 
-  x = chk_alloc (M, sizeof *x);
-  y = chk_alloc (M, sizeof *y);
+  for (i = 0; i<wm; i++) x[i] = y[i] = 0;
+  for (i = 0; i<wn; i++) z[i] = 0;
 
   /* Multiply the vector of source bits by the systematic columns of the 
-     parity check matrix, giving x.  Also copy these bits to the coded block. */
-
-  for (i = 0; i<M; i++) x[i] = 0;
+     parity check matrix, giving x.  Also put these bits in the coded block. */
 
   for (j = M; j<N; j++)
   { 
-    cblk[cols[j]] = sblk[j-M];
-
     if (sblk[j-M]==1)
-    { for (e = mod2sparse_first_in_col(H,cols[j]);
-           !mod2sparse_at_end(e);
-           e = mod2sparse_next_in_col(e))
-      { x[mod2sparse_row(e)] ^= 1;
+    { se_put(z,cols[j],1);
+      for (k = h_start[j-M]; k<h_start[j-M+1]; k++)
+      { x[h_row[k]>>6] ^= (uint64_t)1 << (h_row[k]&63);
       }
     }
   }
  
   /* Solve Ly=x for y by forward substitution, then U(cblk)=y by backward
-     substitution. */
+     substitution.  Bits with a zero on the diagonal are set to zero, which
+     is arbitrary (the parity check matrix must have redundant rows). */
 
-  if (!mod2sparse_forward_sub(L,rows,x,y)
-   || !mod2sparse_backward_sub(U,cols,y,cblk))
-  { 
-    abort(); /* Shouldn't occur, even if the parity check matrix has 
-                redundant rows */
+  for (i = 0; i<M; i++)
+  { b = se_bit(x,l_x[i]);
+    for (k = l_start[i]; k<l_start[i+1]; k++)
+    { b ^= se_bit(y,l_col[k]);
+    }
+    se_put(y,i,b&l_diag[i]);
   }
 
-  free(x);
-  free(y);
+  for (i = M-1; i>=0; i--)
+  { b = se_bit(y,i);
+    for (k = u_start[i]; k<u_start[i+1]; k++)
+    { b ^= se_bit(z,u_col[k]);
+    }
+    se_put(z,cols[i],b&u_diag[i]);
+  }
+
+  for (j = 0; j<N; j++)
+  { cblk[j] = se_bit(z,j);
+  }
 }
 
 
@@ -152,3 +304,484 @@ void mixed_encode
   { cblk[cols[j]] = mod2dense_get(v,j,0);
   }
 }
+
+
+/* ENCODE A BLOCK USING A RICHARDSON-URBANKE REPRESENTATION.  The rows of H
+   in the order given by 'rows' have the form
+
+       [ T  B  A ]        T lower-triangular with ones on its diagonal
+       [ E  D  C ]        E, D and C having only 'gap' rows
+
+   when its columns are put in the order given by 'cols'.  (Note that this 
+   order is T, B, A from right to left, so the message bits come last as for
+   other types.)  The check bits for the B columns are found from the message
+   bits using G, the inverse of the gap matrix D + E Inv(T) B, after which 
+   those for the T columns are found by forward substitution.  The work 
+   needed is proportional to the number of 1s in H, plus the square of the
+   gap. */
+
+static int *ru_start, *ru_pos;	/* Positions in 'cols' of the bits in each 
+				   row, leaving out the diagonal of T */
+static char *ru_ginv;		/* Inverse of the gap matrix, by rows */
+
+static _Thread_local uint64_t *ru_v, *ru_e; /* Bits in order of 'cols', and 
+					       parity of gap rows */
+
+void ru_encode_setup (void)
+{
+  mod2entry *e;
+  int *pos;
+  int i, j, q, n;
+
+  if (ru_start) return;
+
+  pos = chk_alloc (N, sizeof *pos);
+  for (q = 0; q<N; q++) 
+  { pos[cols[q]] = q;
+  }
+
+  n = 0;
+  for (i = 0; i<M; i++)
+  { n += mod2sparse_count_row(H,rows[i]);
+  }
+
+  ru_start = chk_alloc (M+1, sizeof *ru_start);
+  ru_pos = chk_alloc (n+1, sizeof *ru_pos);
+
+  n = 0;
+  for (i = 0; i<M; i++)
+  { ru_start[i] = n;
+    j = 0;
+    for (e = mod2sparse_first_in_row(H,rows[i]);
+         !mod2sparse_at_end(e);
+         e = mod2sparse_next_in_row(e))
+    { q = pos[mod2sparse_col(e)];
+      if (i<M-gap && q==gap+i) 
+      { j = 1;
+      }
+      else if (i<M-gap && q>gap+i && q<M)
+      { j = -1;
+        break;
+      }
+      else
+      { ru_pos[n++] = q;
+      }
+    }
+    if (i<M-gap && j!=1)
+    { fprintf(stderr,"ru_encode_setup: Rows are not lower-triangular\n");
+      exit(1);
+    }
+  }
+  ru_start[M] = n;
+
+  ru_ginv = chk_alloc (gap*gap+1, sizeof *ru_ginv);
+  for (i = 0; i<gap; i++)
+  { for (j = 0; j<gap; j++)
+    { ru_ginv[i*gap+j] = mod2dense_get(G,i,j);
+    }
+  }
+
+  free(pos);
+}
+
+/* Find the check bits, with the message bits already in v[M] to v[N-1].
+   Each word holds bits for as many blocks as are being done together. */
+
+static void ru_solve
+( uint64_t *v,		/* Bits, in the order of 'cols' */
+  uint64_t *e		/* Space for the parities of the gap rows */
+)
+{
+  int *start, *pos;
+  uint64_t w;
+  int i, j, k, t, T;
+
+  start = ru_start;
+  pos = ru_pos;
+  T = M-gap;
+
+  for (j = 0; j<gap; j++) v[j] = 0;
+
+  /* Solve for the T columns with the B columns taken as zero, giving 
+     Inv(T) A times the message, then find the parities of the gap rows. */
+
+  for (t = 0; t<T; t++)
+  { w = 0;
+    for (k = start[t]; k<start[t+1]; k++) w ^= v[pos[k]];
+    v[gap+t] = w;
+  }
+
+  if (gap==0) return;
+
+  for (i = 0; i<gap; i++)
+  { w = 0;
+    for (k = start[T+i]; k<start[T+i+1]; k++) w ^= v[pos[k]];
+    e[i] = w;
+  }
+
+  /* Find the B columns from these, then solve for the T columns again. */
+
+  for (j = 0; j<gap; j++)
+  { w = 0;
+    for (i = 0; i<gap; i++) 
+    { if (ru_ginv[j*gap+i]) w ^= e[i];
+    }
+    v[j] = w;
+  }
+
+  for (t = 0; t<T; t++)
+  { w = 0;
+    for (k = start[t]; k<start[t+1]; k++) w ^= v[pos[k]];
+    v[gap+t] = w;
+  }
+}
+
+void ru_encode
+( char *sblk,
+  char *cblk
+)
+{
+  int q;
+
+  if (!ru_v)
+  { ru_v = chk_alloc (N, sizeof *ru_v);
+    ru_e = chk_alloc (gap+1, sizeof *ru_e);
+  }
+
+  for (q = M; q<N; q++) 
+  { ru_v[q] = sblk[q-M];
+  }
+
+  ru_solve (ru_v, ru_e);
+
+  for (q = 0; q<N; q++)
+  { cblk[cols[q]] = ru_v[q];
+  }
+}
+
+
+/* ENCODE A BLOCK BY TABLE LOOKUP.  The check bits are a linear function of 
+   the source bits, so for each byte of source bits a table is made of the
+   check bits (packed) for all 256 values of that byte.  Encoding a block
+   then takes one lookup per source byte, with the results XORed together.
+   The tables take (N-M)*M*4 bytes, so table_encode_setup declines to make
+   them (returning 0) if this would exceed Enc_table_limit. */
+
+#define Enc_table_limit (64<<20) /* Largest space allowed for tables */
+
+static int te_words;		/* Number of words of packed check bits */
+static uint64_t *te_table;	/* Tables for each byte of source bits */
+
+static _Thread_local uint64_t *te_chk; /* Packed check bits for a block */
+
+int table_encode_setup (void)
+{
+  uint64_t *col, *t;
+  char *sblk, *cblk;
+  int K, P, W, i, j, k, p, b;
+
+  if (te_table) return 1;
+
+  K = N-M;
+  P = (K+7) / 8;
+  W = (M+63) / 64;
+
+  if ((double)P*256*W*sizeof *te_table > Enc_table_limit) return 0;
+
+  /* Find the check bits for each source bit by itself. */
+
+  col = chk_alloc (P*8*W, sizeof *col);
+
+  switch (type)
+  { 
+    case 'd':
+    { for (j = 0; j<K; j++)
+      { for (i = 0; i<M; i++)
+        { if (mod2dense_get(G,i,j)) col[j*W+i/64] |= (uint64_t)1 << (i%64);
+        }
+      }
+      break;
+    }
+
+    case 'm':
+    { se_h_setup();
+      for (j = 0; j<K; j++)
+      { for (k = se_h_start[j]; k<se_h_start[j+1]; k++)
+        { for (i = 0; i<M; i++)
+          { if (mod2dense_get(G,i,se_h_row[k])) 
+            { col[j*W+i/64] ^= (uint64_t)1 << (i%64);
+            }
+          }
+        }
+      }
+      break;
+    }
+
+    case 's': case 'r':
+    { if (type=='s') sparse_encode_setup();
+      else ru_encode_setup();
+      sblk = chk_alloc (K, sizeof *sblk);
+      cblk = chk_alloc (N, sizeof *cblk);
+      for (j = 0; j<K; j++)
+      { sblk[j] = 1;
+        if (type=='s') sparse_encode (sblk, cblk);
+        else ru_encode (sblk, cblk);
+        sblk[j] = 0;
+        for (i = 0; i<M; i++)
+        { if (cblk[cols[i]]) col[j*W+i/64] |= (uint64_t)1 << (i%64);
+        }
+      }
+      free(sblk);
+      free(cblk);
+      break;
+    }
+  }
+
+  /* Make the table for each byte, building each entry from one with a bit
+     less set.  Bits past the end of the last byte have zero columns. */
+
+  te_table = chk_alloc (P*256*W, sizeof *te_table);
+
+  for (p = 0; p<P; p++)
+  { t = te_table + p*256*W;
+    for (b = 1; b<256; b++)
+    { k = __builtin_ctz(b);
+      for (i = 0; i<W; i++)
+      { t[b*W+i] = t[(b&(b-1))*W+i] ^ col[(p*8+k)*W+i];
+      }
+    }
+  }
+
+  free(col);
+
+  te_words = W;
+
+  return 1;
+}
+
+void table_encode
+( char *sblk,
+  char *cblk
+)
+{
+  uint64_t *t, *c;
+  int K, W, i, j, p, b;
+
+  K = N-M;
+  W = te_words;
+
+  if (!te_chk)
+  { te_chk = chk_alloc (W, sizeof *te_chk);
+  }
+
+  c = te_chk;
+  for (i = 0; i<W; i++) c[i] = 0;
+
+  /* Copy the source bits to the coded block, then look up each byte of them. */
+
+  for (j = 0; j<K; j++)
+  { cblk[cols[M+j]] = sblk[j];
+  }
+
+  for (p = 0; p*8<K; p++)
+  { b = 0;
+    if (p*8+8<=K)
+    { for (j = 0; j<8; j++) b |= (sblk[p*8+j]&1) << j;
+    }
+    else
+    { for (j = 0; p*8+j<K; j++) b |= (sblk[p*8+j]&1) << j;
+    }
+    t = te_table + (p*256+b)*W;
+    for (i = 0; i<W; i++) c[i] ^= t[i];
+  }
+
+  /* Copy check bits to the right places in the coded block. */
+
+  for (i = 0; i<M; i++)
+  { cblk[cols[i]] = (c[i/64] >> (i%64)) & 1;
+  }
+}
+
+
+/* ENCODE A BATCH OF BLOCKS AT ONCE.  The blocks are "bit-sliced", with bit
+   b of word j holding bit j of block b, so that each operation on words 
+   handles up to 64 blocks.  Sparse generators use the plan made by 
+   sparse_encode_setup; for dense and mixed generators, the positions of 
+   the 1s in each column of G are listed, unless table lookup (which is
+   faster for these) can be used instead.  Richardson-Urbanke generators 
+   use the same procedure as ru_encode, on words of bits. */
+
+static int *be_g_start, *be_g_row; /* Rows of G with 1s, for each column */
+
+static _Thread_local uint64_t *be_s, *be_x, *be_y, *be_z; /* Sliced bits */
+
+void batch_encode_setup (void)
+{
+  int i, j, n;
+
+  if (type=='s')
+  { sparse_encode_setup();
+    return;
+  }
+
+  if (type=='r')
+  { ru_encode_setup();
+    return;
+  }
+
+  if (be_g_start || table_encode_setup()) return;
+
+  if (type=='m') 
+  { se_h_setup();
+  }
+
+  be_g_start = chk_alloc (mod2dense_cols(G)+1, sizeof *be_g_start);
+
+  n = 0;
+  for (j = 0; j<mod2dense_cols(G); j++)
+  { for (i = 0; i<M; i++) n += mod2dense_get(G,i,j);
+  }
+  be_g_row = chk_alloc (n+1, sizeof *be_g_row);
+
+  n = 0;
+  for (j = 0; j<mod2dense_cols(G); j++)
+  { be_g_start[j] = n;
+    for (i = 0; i<M; i++) 
+    { if (mod2dense_get(G,i,j)) be_g_row[n++] = i;
+    }
+  }
+  be_g_start[mod2dense_cols(G)] = n;
+}
+
+void batch_encode
+( int nb,		/* Number of blocks, from 1 to Enc_batch */
+  char *sblk,		/* Source blocks, each N-M bits, one after another */
+  char *cblk		/* Place to store encoded blocks, each N bits */
+)
+{
+  uint64_t *s, *x, *y, *z, *u, w;
+  int *start, *index;
+  int K, b, i, j, k;
+
+  K = N-M;
+
+  if (!be_s)
+  { be_s = chk_alloc (N, sizeof *be_s);
+    be_x = chk_alloc (M, sizeof *be_x);
+    be_y = chk_alloc (M+gap, sizeof *be_y);
+    be_z = chk_alloc (N, sizeof *be_z);
+  }
+
+  /* Dense and mixed generators use lookup tables if they were made, one
+     block at a time. */
+
+  if ((type=='d' || type=='m') && te_table)
+  { for (b = 0; b<nb; b++) 
+    { table_encode (sblk+b*K, cblk+b*N);
+    }
+    return;
+  }
+
+  s = be_s; x = be_x; y = be_y; z = be_z;
+
+  /* Slice the source blocks, and put them in the coded blocks. */
+
+  for (j = 0; j<K; j++) s[j] = 0;
+
+  for (b = 0; b<nb; b++)
+  { for (j = 0; j<K; j++) 
+    { s[j] |= (uint64_t)(sblk[b*K+j]&1) << b;
+    }
+  }
+
+  for (j = M; j<N; j++) 
+  { z[cols[j]] = s[j-M];
+  }
+
+  /* Richardson-Urbanke generators find all bits in the order of 'cols', with
+     the source bits placed after the check bits. */
+
+  if (type=='r')
+  { for (j = K-1; j>=0; j--) s[M+j] = s[j];
+    ru_solve (s, y);
+    for (j = 0; j<M; j++) z[cols[j]] = s[j];
+  }
+
+  /* Multiply the source bits by the message bit columns of the parity check
+     matrix, unless G applies to the source bits directly. */
+
+  if (type!='d' && type!='r')
+  { start = se_h_start;
+    index = se_h_row;
+    for (i = 0; i<M; i++) x[i] = 0;
+    for (j = 0; j<K; j++)
+    { w = s[j];
+      for (k = start[j]; k<start[j+1]; k++) x[index[k]] ^= w;
+    }
+  }
+
+  /* Find the check bits. */
+
+  switch (type)
+  { 
+    case 's':
+    { 
+      start = se_l_start;
+      index = se_l_col;
+      for (i = 0; i<M; i++)
+      { w = x[se_l_x[i]];
+        for (k = start[i]; k<start[i+1]; k++) w ^= y[index[k]];
+        y[i] = se_l_diag[i] ? w : 0;
+      }
+
+      start = se_u_start;
+      index = se_u_col;
+      for (i = M-1; i>=0; i--)
+      { w = y[i];
+        for (k = start[i]; k<start[i+1]; k++) w ^= z[index[k]];
+        z[cols[i]] = se_u_diag[i] ? w : 0;
+      }
+
+      break;
+    }
+
+    case 'd': case 'm':
+    { 
+      u = type=='d' ? s : x;
+      start = be_g_start;
+      index = be_g_row;
+      for (i = 0; i<M; i++) y[i] = 0;
+      for (j = 0; j<mod2dense_cols(G); j++)
+      { w = u[j];
+        for (k = start[j]; k<start[j+1]; k++) y[index[k]] ^= w;
+      }
+      for (i = 0; i<M; i++) 
+      { z[cols[i]] = y[i];
+      }
+
+      break;
+    }
+  }
+
+  /* Unslice the coded blocks. */
+
+  for (b = 0; b<nb; b++)
+  { for (j = 0; j<N; j++)
+    { cblk[b*N+j] = (z[j]>>b) & 1;
+    }
+  }
+}
+
+
+/* SEE WHETHER AN ENCODED BLOCK SHOULD BE VERIFIED.  One block in every 
+   "every" is checked to be a code word (none if every is zero), at an offset
+   that changes from one run of blocks to the next, so that every position 
+   in a batch of blocks is eventually checked.  Block 0 is always checked. */
+
+int encode_verified
+( long n,		/* Number of block, from zero */
+  int every		/* Check one block in this many, or 0 for none */
+)
+{
+  return every>0 && n%every == (n/every%every) * Enc_verify_stride % every;
+}
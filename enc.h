@@ -13,6 +13,25 @@
  * application.  All use of these programs is entirely at the user's own risk.
  */
 
+void sparse_encode_setup (void);
 void sparse_encode (char *, char *);
 void dense_encode  (char *, char *, mod2dense *, mod2dense *);
 void mixed_encode  (char *, char *, mod2dense *, mod2dense *);
+
+void ru_encode_setup (void);
+void ru_encode (char *, char *);
+
+int  table_encode_setup (void);
+void table_encode (char *, char *);
+
+#define Enc_batch 64	/* Maximum number of blocks for batch_encode */
+
+void batch_encode_setup (void);
+void batch_encode (int, char *, char *);
+
+#define Enc_verify_default 64	/* Check one encoded block in this many, by 
+				   default */
+#define Enc_verify_stride 7919	/* Odd step between the offsets of sampled 
+				   blocks in successive runs */
+
+int encode_verified (long, int);
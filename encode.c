@@ -37,6 +37,7 @@
 #include <string.h>
 #include <math.h>
 #include <time.h>    
+#include <sys/types.h>
 
 #include "rand.h"
 #include "alloc.h"
@@ -47,11 +48,15 @@
 #include "mod2convert.h"
 #include "rcode.h"
 #include "enc.h"
+#include "check.h"
 #include "int2bin.h"
 #include "crc.h"
 #include "version.h"
 
+#define Meta_width 20		/* Digits reserved for each size in <Meta> */
+
 void usage(void);
+static void write_sizes (FILE *, long, long, int);
 
 
 /* MAIN PROGRAM. */
@@ -62,18 +67,21 @@ int main
 )
 {
   crc_t crc;
-  char *source_file, *encoded_file, *temp_file;
+  char *source_file, *encoded_file;
   char *pchk_file, *gen_file;
-  mod2dense *u, *v;
 
   FILE *srcf, *encf;
   char *sblk, *cblk, *chks;
-  char ch;
   char block_pos[80],header_crc[80];
-  int i, n;
+  int i, b, nb;
+  long n, n_verified;
+  int verify_every;
+  int at_eof;
+  char junk;
   int last_pos=0;
   int k;
-  int fz; //file_size
+  long fz; //file_size
+  off_t meta_pos;
   char terminator[4097]=version_terminator;
   
 
@@ -89,6 +97,23 @@ int main
   
   /* Look at arguments. */
 
+  verify_every = Enc_verify_default;
+
+  if (argc>1 && strncmp(argv[1],"--verify=",9)==0)
+  { if (strcmp(argv[1]+9,"full")==0)
+    { verify_every = 1;
+    }
+    else if (strcmp(argv[1]+9,"off")==0)
+    { verify_every = 0;
+    }
+    else if (sscanf(argv[1]+9,"sample:%d%c",&verify_every,&junk)!=1 
+              || verify_every<1)
+    { usage();
+    }
+    argc -= 1;
+    argv += 1;
+  }
+
   if (!(pchk_file = argv[1])
    || !(gen_file = argv[2])
    || !(source_file = argv[3])
@@ -107,6 +132,7 @@ int main
   /* Read parity check file */
 
   read_pchk(pchk_file);
+  check_setup(H);
 
   if (N<=M)
   { fprintf(stderr,
@@ -119,17 +145,9 @@ int main
 
   read_gen(gen_file,0,0);
 
-  /* Allocate needed space. */
+  /* Set up for encoding blocks in batches. */
 
-  if (type=='d')
-  { u = mod2dense_allocate(N-M,1);
-    v = mod2dense_allocate(M,1);
-  }
-
-  if (type=='m')
-  { u = mod2dense_allocate(M,1);
-    v = mod2dense_allocate(M,1);
-  }
+  batch_encode_setup();
 
   /* Open source file. */
 
@@ -139,134 +157,135 @@ int main
     exit(1);
   }
 
-  
-  /* Create temp encoded output file. */
-  temp_file=(char*)chk_alloc(strlen(encoded_file)+10, sizeof(char));
-  strcat(temp_file,encoded_file);
-  strcat(temp_file,".tmp");
-  encf = open_file_std(temp_file,"w");
+  /* Create encoded output file, and write the meta-information.  The sizes
+     aren't known until the end, so fixed-width space is left for them, to
+     be filled in then if the file can be rewound (not if it's a pipe). */
+
+  encf = open_file_std(encoded_file,"w");
   if (encf==NULL)
-  { fprintf(stderr,"Can't create file for temp encoded data: %s\n",temp_file);
+  { fprintf(stderr,"Can't create file for encoded data: %s\n",encoded_file);
     exit(1);
   }
+
+  fprintf(encf, "<?xml version='1.0'?>\n<root>\n<Meta>\n\t<Source_file>%s</Source_file>\n",source_file);
+  meta_pos = ftello(encf);
+  write_sizes(encf,-1,-1,-1);
+  fprintf(encf, "\t<Date>%s</Date>\n</Meta>\n<Blocks>\n",date);
   
-  sblk = chk_alloc (N-M, sizeof *sblk);
-  cblk = chk_alloc (N, sizeof *cblk);
+  sblk = chk_alloc ((N-M)*Enc_batch, sizeof *sblk);
+  cblk = chk_alloc (N*Enc_batch, sizeof *cblk);
   chks = chk_alloc (M, sizeof *chks);
 
   /* Prepare the double terminator */ 
   for (k=0;k<=(N-M)/190;k++){
     strcat(terminator, version_terminator);
   } 
-  /* Encode successive blocks. */
-  for (n = 0; ; n++)
+  /* Encode successive batches of blocks. */
+
+  n_verified = 0;
+
+  for (n = 0; ; )
   { 
-    /* Read block from source file. */
-    if (blockio_read_bin(srcf,sblk,N-M,&last_pos)==EOF) 
-    { /* Pad the short block with double terminator seq */
+    /* Read blocks from source file, up to the last one, which is the one
+       that is short (perhaps with no data at all). */
+    for (nb = 0; nb<Enc_batch; )
+    { at_eof = blockio_read_bin(srcf,sblk+nb*(N-M),N-M,&last_pos)==EOF;
+      if (at_eof) 
+      { /* Pad the short block with double terminator seq */
 	for (k=0;k+last_pos<N-M;k++){
-	  sblk[last_pos+k]=terminator[k]=='1';
+	  sblk[nb*(N-M)+last_pos+k]=terminator[k]=='1';
 	}	
-    }
-
-    /* Compute encoded block. */
-
-    switch (type)
-    { case 's':
-      { sparse_encode (sblk, cblk);
-        break;
-      }
-      case 'd':
-      { dense_encode (sblk, cblk, u, v);
-        break;
-      }
-      case 'm':
-      { mixed_encode (sblk, cblk, u, v);
-        break;
       }
+      nb += 1;
+      if (at_eof) break;
     }
 
-    /* Check that encoded block is a code word. */
+    /* Compute encoded blocks. */
 
-    mod2sparse_mulvec (H, cblk, chks);
+    batch_encode (nb, sblk, cblk);
 
-    for (i = 0; i<M; i++) 
-    { if (chks[i]==1)
-      { fprintf(stderr,"Output block %d is not a code word!  (Fails check %d)\n",n,i);
-        abort(); 
+    for (b = 0; b<nb; b++, n++)
+    {
+      /* Check that encoded block is a code word, if it is one of those 
+         sampled. */
+
+      if (encode_verified (n, verify_every))
+      { if (check (H, cblk+b*N, chks)!=0)
+        { for (i = 0; chks[i]==0; i++) ;
+          fprintf(stderr,"Output block %ld is not a code word!  (Fails check %d)\n",n,i);
+          abort(); 
+        }
+        n_verified += 1;
       }
-    }
-    /* Write block header */
-    int2bin_evenpad(n,block_pos);
-    crc = crc_init();
-    crc = crc_update(crc, (unsigned char *)block_pos, strlen(block_pos));
-    crc = crc_finalize(crc);
-    int2bin(crc,header_crc);
-    fprintf(encf,"<Block>\n\t<Header>\n\t\t<Version>%s</Version>\n\t\t<Position>%s</Position>\n\t\t<Header_Checksum>%s</Header_Checksum>\n\t</Header>\n",version_5prime,block_pos,header_crc);
+      /* Write block header */
+      int2bin_evenpad(n,block_pos);
+      crc = crc_init();
+      crc = crc_update(crc, (unsigned char *)block_pos, strlen(block_pos));
+      crc = crc_finalize(crc);
+      int2bin(crc,header_crc);
+      fprintf(encf,"<Block>\n\t<Header>\n\t\t<Version>%s</Version>\n\t\t<Position>%s</Position>\n\t\t<Header_Checksum>%s</Header_Checksum>\n\t</Header>\n",version_5prime,block_pos,header_crc);
 
-    /* Write encoded block to encoded output file. */
+      /* Write encoded block to encoded output file. */
 
-    blockio_write(encf,cblk,N);
+      blockio_write(encf,cblk+b*N,N);
+    }
 
     /* Break if last block is the last block */
-    if (feof(srcf)){
-	fz=ftell(srcf);
+    if (at_eof){
+	fz=(n-1)*(long)((N-M)/8)+last_pos/8;
 	break;
     }
   }
   fprintf(encf,"</Blocks>\n</root>");
-  fprintf(stderr,
-    "Encoded %d blocks, source block size %d, encoded block size %d\nPosition %d to %d of the last block was padded with double terminator\n",n+1,N-M,N,last_pos,N-M);
 
-  if (ferror(encf) || fclose(encf)!=0)
-  { fprintf(stderr,"Error writing encoded blocks to %s\n",strcat(encoded_file,".tmp"));
-    exit(1);
+  if (meta_pos>=0 && fseeko(encf,meta_pos,SEEK_SET)==0)
+  { write_sizes(encf,fz,n,last_pos);
+    fseeko(encf,0,SEEK_END);
   }
-  
-  /* Write meta-information */
-  fclose(srcf);
-   
-  srcf = open_file_std(temp_file,"r");
-  if (srcf==NULL)
-  { fprintf(stderr,"Can't open temp file: %s\n",temp_file);
-    exit(1);
+  else
+  { clearerr(encf);
   }
 
-  encf = open_file_std(encoded_file,"w");
-  if (encf==NULL)
-  { fprintf(stderr,"Can't create file for encoded data: %s\n",encoded_file);
-    exit(1);
+  fprintf(stderr,
+    "Encoded %ld blocks, source block size %d, encoded block size %d\nPosition %d to %d of the last block was padded with double terminator\n",n,N-M,N,last_pos,N-M);
+  if (verify_every==0)
+  { fprintf(stderr,"Blocks were not verified to be code words\n");
+  }
+  else
+  { fprintf(stderr,"Verified %ld of %ld blocks to be code words\n",n_verified,n);
   }
-
-  fprintf(encf, "<?xml version='1.0'?>\n<root>\n<Meta>\n\t<Source_file>%s</Source_file>\n\t<File_size>%d</File_size>\n\t<Num_Blocks>%d</Num_Blocks>\n\t<Last_pos>%d</Last_pos>\n\t<Date>%s</Date>\n</Meta>\n<Blocks>\n",source_file,fz,n+1,last_pos,date);
-  
-  /* Copy temp file to the new file */
-  while(1)
-    {
-       ch = fgetc(srcf);
-
-       if(ch==EOF)
-          break;
-       else
-          putc(ch,encf);
-    }
 
   if (ferror(encf) || fclose(encf)!=0)
-  { fprintf(stderr,"Error writing encoded blocks to %s\n",temp_file);
+  { fprintf(stderr,"Error writing encoded blocks to %s\n",encoded_file);
     exit(1);
   }
-  if( remove( temp_file ) == -1 )
-        fprintf(stderr,"Error deleting temp file %s\n",temp_file);
-        exit(1);
+
+  fclose(srcf);
   
   return 0;
 }
 
 
+/* WRITE THE SIZES IN THE META-INFORMATION.  Each is written with the same
+   width whatever its value, so that they can be overwritten in place, with
+   -1 for a size not yet known. */
+
+static void write_sizes
+( FILE *f,		/* File to write to */
+  long fz,		/* Size of source file in bytes */
+  long n,		/* Number of blocks */
+  int last_pos		/* Position in last block where padding starts */
+)
+{
+  fprintf(f, "\t<File_size>%0*ld</File_size>\n\t<Num_Blocks>%0*ld</Num_Blocks>\n\t<Last_pos>%0*d</Last_pos>\n",
+    Meta_width,fz,Meta_width,n,Meta_width,last_pos);
+}
+
+
 /* PRINT USAGE MESSAGE AND EXIT. */
 
 void usage(void)
 { fprintf(stderr,
-   "Usage:  encode pchk-file gen-file source-file encoded-file\n");
+   "Usage:  encode [ --verify=full|sample:N|off ] pchk-file gen-file source-file\n         encoded-file\n");
   exit(1);
 }
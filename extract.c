@@ -43,6 +43,7 @@ int main
   FILE *codef, *extf;
   char *cblk;
   int i;
+  int packed;
 
   /* Look at arguments. */
 
@@ -71,6 +72,8 @@ int main
     exit(1);
   }
 
+  packed = blockio_read_header(codef,N);
+
   /* Open file to write extracted message bits to. */
 
   extf = open_file_std(ext_file,"wb");
@@ -84,7 +87,8 @@ int main
   char block[N+1024];
 
   /* Read block from coded file. */
-  if (blockio_read(codef,cblk,N)==EOF){fprintf(stderr,"Error reading decoded file!\n");}
+  if ((packed ? blockio_read_packed(codef,cblk,N) 
+              : blockio_read(codef,cblk,N))==EOF){fprintf(stderr,"Error reading decoded file!\n");}
 
   for (;;)
   { 
@@ -99,7 +103,8 @@ int main
     block[N-M]='\0';
     
     /* Check if last block */
-    if (blockio_read(codef,cblk,N)==EOF) {
+    if ((packed ? blockio_read_packed(codef,cblk,N) 
+                : blockio_read(codef,cblk,N))==EOF) {
 	char temp_str[strlen(version_terminator)];
         char *p;
         //remove terminator padding
@@ -114,11 +119,11 @@ int main
 		}
 	}
         /* Write buffered block */
-        blockio_write_bin (extf, block, strlen(block)/8);
+        blockio_write_bin (extf, block, strlen(block)/8*8);
 	break;
     }
     /* Write buffered block */
-    blockio_write_bin (extf, block, strlen(block)/8);
+    blockio_write_bin (extf, block, strlen(block)/8*8);
   }
 
   if (ferror(extf) || fclose(extf)!=0)
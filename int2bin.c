@@ -49,10 +49,10 @@ void int2bin_evenpad(long decimal, char *binary)
     temp[k++] = '-';       // add - sign
   
   // reverse the spelling
-  while (k >= 0)
+  while (k > 0)
     binary[n++] = temp[--k];
  
-  binary[n-1] = 0;         // end with NULL
+  binary[n] = 0;           // end with NULL
 
 }
 
@@ -85,9 +85,9 @@ void int2bin(long decimal, char *binary)
     temp[k++] = '-';       // add - sign
   
   // reverse the spelling
-  while (k >= 0)
+  while (k > 0)
     binary[n++] = temp[--k];
  
-  binary[n-1] = 0;         // end with NULL
+  binary[n] = 0;           // end with NULL
 
 }
@@ -1,3 +1,3 @@
 /* int2bin.h - Routines to convert long integer to binary string */
-void int2bin_evenpadded(long,char *);
+void int2bin_evenpad(long,char *);
 void int2bin(long,char *);
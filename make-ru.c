@@ -0,0 +1,348 @@
+/* MAKE-RU.C - Make a Richardson-Urbanke generator for a parity check matrix. */
+
+/* Copyright (c) 2000, 2001 by Radford M. Neal
+ *
+ * Permission is granted for anyone to copy, use, modify, or distribute this
+ * program and accompanying programs and documents for any purpose, provided
+ * this copyright notice is retained and prominently displayed, along with
+ * a note saying that the original programs are available from Radford Neal's
+ * web page, and note is made of any changes made to the programs.  The
+ * programs and documents are distributed without any warranty, express or
+ * implied.  As the programs were written for research purposes only, they have
+ * not been tested to the degree that would be advisable in any important
+ * application.  All use of these programs is entirely at the user's own risk.
+ */
+
+/* The rows and columns of the parity check matrix are reordered so that
+   most of it is lower-triangular, as described in enc.c, by the greedy
+   method of Richardson and Urbanke: a row with only one bit not yet placed
+   has that bit put on the diagonal, and when there is no such row, all but
+   one of the unplaced bits in a row with fewest of them are made "known"
+   (message bits or gap bits).  Rows left with no unplaced bits form the gap.
+   Gap bits are chosen from the known bits so that the gap matrix can be
+   inverted.  The result is written as a generator file of type 'r'. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "alloc.h"
+#include "intio.h"
+#include "open.h"
+#include "mod2sparse.h"
+#include "mod2dense.h"
+#include "mod2convert.h"
+#include "rcode.h"
+#include "enc.h"
+
+void usage(void);
+
+static void place (int, int);
+
+static int *col_state;		/* 0 if not placed, 1 if on diagonal, 2 if
+				   known */
+static int *row_state;		/* 0 if active, 1 if triangular, 2 if gap */
+static int *row_deg;		/* Number of unplaced bits in each row */
+
+static int *stack, n_stack;	/* Rows that may have only one unplaced bit */
+static int *gap_rows, n_gap;	/* Rows in the gap, in order found */
+
+
+/* MAIN PROGRAM. */
+
+int main
+( int argc,
+  char **argv
+)
+{
+  char *pchk_file, *gen_file;
+  mod2dense *W, *Q, *R, *S, *Si, *Gi;
+  mod2entry *e;
+  int *tri_rows, *tri_cols, *known, *qrows, *qcols, *pos;
+  int n_tri, n_known, r;
+  int i, j, k, t, c, n;
+  char *sblk, *cblk, *chks;
+  FILE *f;
+
+  /* Look at arguments. */
+
+  if (!(pchk_file = argv[1])
+   || !(gen_file = argv[2])
+   || argv[3])
+  { usage();
+  }
+
+  read_pchk(pchk_file);
+
+  if (N<=M)
+  { fprintf(stderr,
+ "Can't encode if number of bits (%d) not greater than number of checks (%d)\n",
+      N,M);
+    exit(1);
+  }
+
+  col_state = chk_alloc (N, sizeof *col_state);
+  row_state = chk_alloc (M, sizeof *row_state);
+  row_deg = chk_alloc (M, sizeof *row_deg);
+  stack = chk_alloc (N+M, sizeof *stack);
+  gap_rows = chk_alloc (M, sizeof *gap_rows);
+
+  tri_rows = chk_alloc (M, sizeof *tri_rows);
+  tri_cols = chk_alloc (M, sizeof *tri_cols);
+  known = chk_alloc (N, sizeof *known);
+
+  n_stack = 0;
+  n_gap = 0;
+
+  for (i = 0; i<M; i++)
+  { row_deg[i] = mod2sparse_count_row(H,i);
+    if (row_deg[i]==1) stack[n_stack++] = i;
+    if (row_deg[i]==0)
+    { row_state[i] = 2;
+      gap_rows[n_gap++] = i;
+    }
+  }
+
+  /* Triangulate greedily. */
+
+  n_tri = 0;
+
+  for (;;)
+  {
+    while (n_stack>0)
+    { i = stack[--n_stack];
+      if (row_state[i]!=0 || row_deg[i]!=1) continue;
+      for (e = mod2sparse_first_in_row(H,i);
+           col_state[mod2sparse_col(e)]!=0;
+           e = mod2sparse_next_in_row(e)) ;
+      row_state[i] = 1;
+      tri_rows[n_tri] = i;
+      tri_cols[n_tri] = mod2sparse_col(e);
+      n_tri += 1;
+      place (mod2sparse_col(e), 1);
+    }
+
+    i = -1;
+    for (k = 0; k<M; k++)
+    { if (row_state[k]==0 && (i<0 || row_deg[k]<row_deg[i])) i = k;
+    }
+    if (i<0) break;
+
+    /* Make all but the unplaced bit with fewest checks known. */
+
+    c = -1;
+    for (e = mod2sparse_first_in_row(H,i);
+         !mod2sparse_at_end(e);
+         e = mod2sparse_next_in_row(e))
+    { j = mod2sparse_col(e);
+      if (col_state[j]==0 && (c<0 || mod2sparse_count_col(H,j)
+                                        < mod2sparse_count_col(H,c))) c = j;
+    }
+    for (e = mod2sparse_first_in_row(H,i);
+         !mod2sparse_at_end(e);
+         e = mod2sparse_next_in_row(e))
+    { j = mod2sparse_col(e);
+      if (col_state[j]==0 && j!=c) place (j, 2);
+    }
+  }
+
+  n_known = 0;
+  for (j = 0; j<N; j++)
+  { if (col_state[j]!=1) known[n_known++] = j;
+  }
+
+  if (n_tri+n_gap!=M || n_known!=N-M+n_gap) abort();
+
+  gap = n_gap;
+
+  /* Find the gap matrix for every known bit, as the columns of
+     E Inv(T) [A B] + [C D].  The rows of E Inv(T) are found together,
+     going back through the columns of T. */
+
+  pos = chk_alloc (M, sizeof *pos);
+  for (t = 0; t<n_tri; t++) pos[tri_rows[t]] = t;
+  for (i = 0; i<gap; i++) pos[gap_rows[i]] = -1-i;
+
+  Gi = 0;
+
+  if (gap>0)
+  {
+    W = mod2dense_allocate(gap,n_tri>0 ? n_tri : 1);
+
+    for (t = n_tri-1; t>=0; t--)
+    { for (e = mod2sparse_first_in_col(H,tri_cols[t]);
+           !mod2sparse_at_end(e);
+           e = mod2sparse_next_in_col(e))
+      { k = pos[mod2sparse_row(e)];
+        if (k<0)
+        { (void) mod2dense_flip(W,-1-k,t);
+        }
+        else if (k>t)
+        { for (i = 0; i<gap; i++)
+          { if (mod2dense_get(W,i,k)) (void) mod2dense_flip(W,i,t);
+          }
+        }
+      }
+    }
+
+    Q = mod2dense_allocate(gap,n_known);
+
+    for (j = 0; j<n_known; j++)
+    { for (e = mod2sparse_first_in_col(H,known[j]);
+           !mod2sparse_at_end(e);
+           e = mod2sparse_next_in_col(e))
+      { k = pos[mod2sparse_row(e)];
+        if (k<0)
+        { (void) mod2dense_flip(Q,-1-k,j);
+        }
+        else
+        { for (i = 0; i<gap; i++)
+          { if (mod2dense_get(W,i,k)) (void) mod2dense_flip(Q,i,j);
+          }
+        }
+      }
+    }
+
+    /* Pick the gap bits, and find the inverse of their gap matrix.  If some
+       checks are redundant, their gap rows are ignored, and as many gap 
+       bits are always zero. */
+
+    R = mod2dense_allocate(gap,n_known);
+    qrows = chk_alloc (gap, sizeof *qrows);
+    qcols = chk_alloc (n_known, sizeof *qcols);
+
+    S = mod2dense_allocate(gap,n_known);
+    mod2dense_copy(Q,S);
+
+    r = gap - mod2dense_invert_selected(S,R,qrows,qcols);
+    if (r<gap)
+    { fprintf(stderr,
+       "Note: Parity check matrix has %d redundant checks\n", gap-r);
+    }
+
+    Gi = mod2dense_allocate(gap,gap);
+
+    if (r>0)
+    { S = mod2dense_allocate(r,r);
+      Si = mod2dense_allocate(r,r);
+      for (i = 0; i<r; i++)
+      { for (j = 0; j<r; j++)
+        { mod2dense_set(S,i,j,mod2dense_get(Q,qrows[i],qcols[j]));
+        }
+      }
+      if (!mod2dense_invert(S,Si)) abort();
+      for (i = 0; i<r; i++)
+      { for (j = 0; j<r; j++)
+        { mod2dense_set(Gi,j,qrows[i],mod2dense_get(Si,j,i));
+        }
+      }
+    }
+
+    for (j = 0; j<n_known; j++) qcols[j] = known[qcols[j]];
+    for (j = 0; j<n_known; j++) known[j] = qcols[j];
+  }
+
+  /* Set up the generator, in the order used for encoding. */
+
+  type = 'r';
+  G = Gi;
+  cols = chk_alloc (N, sizeof *cols);
+  rows = chk_alloc (M, sizeof *rows);
+
+  for (j = 0; j<gap; j++) cols[j] = known[j];
+  for (t = 0; t<n_tri; t++) cols[gap+t] = tri_cols[t];
+  for (j = gap; j<n_known; j++) cols[M+j-gap] = known[j];
+
+  for (t = 0; t<n_tri; t++) rows[t] = tri_rows[t];
+  for (i = 0; i<gap; i++) rows[n_tri+i] = gap_rows[i];
+
+  /* Check that some messages encode to code words. */
+
+  ru_encode_setup();
+
+  sblk = chk_alloc (N-M, sizeof *sblk);
+  cblk = chk_alloc (N, sizeof *cblk);
+  chks = chk_alloc (M, sizeof *chks);
+
+  for (n = 0; n<10; n++)
+  { for (j = 0; j<N-M; j++)
+    { sblk[j] = n==0 ? 1 : ((unsigned)(j+1)*2654435761u*(n+1) >> 17) & 1;
+    }
+    ru_encode (sblk, cblk);
+    mod2sparse_mulvec (H, cblk, chks);
+    for (i = 0; i<M; i++)
+    { if (chks[i])
+      { fprintf(stderr,"Generator made doesn't produce code words!\n");
+        abort();
+      }
+    }
+  }
+
+  /* Write the generator file. */
+
+  f = open_file_std(gen_file,"wb");
+  if (f==NULL)
+  { fprintf(stderr,"Can't create generator matrix file: %s\n",gen_file);
+    exit(1);
+  }
+
+  intio_write(f,('G'<<8)+0x80);
+  fwrite (&type, 1, 1, f);
+  intio_write(f,M);
+  intio_write(f,N);
+
+  for (j = 0; j<N; j++) intio_write(f,cols[j]);
+  for (i = 0; i<M; i++) intio_write(f,rows[i]);
+
+  intio_write(f,gap);
+  if (gap>0) mod2dense_write(f,G);
+
+  if (ferror(f) || fclose(f)!=0)
+  { fprintf(stderr,"Error writing to generator matrix file %s\n",gen_file);
+    exit(1);
+  }
+
+  fprintf(stderr,"Gap is %d, with %d checks in triangular form\n",gap,n_tri);
+
+  return 0;
+}
+
+
+/* PLACE A BIT ON THE DIAGONAL OR AS KNOWN.  The counts of unplaced bits in
+   the active rows with this bit are reduced, noting rows with one bit left,
+   and moving rows with none left to the gap. */
+
+static void place
+( int j,		/* Index of bit (column) */
+  int state		/* 1 for diagonal, 2 for known */
+)
+{
+  mod2entry *e;
+  int i;
+
+  col_state[j] = state;
+
+  for (e = mod2sparse_first_in_col(H,j);
+       !mod2sparse_at_end(e);
+       e = mod2sparse_next_in_col(e))
+  { i = mod2sparse_row(e);
+    if (row_state[i]!=0) continue;
+    row_deg[i] -= 1;
+    if (row_deg[i]==1)
+    { stack[n_stack++] = i;
+    }
+    if (row_deg[i]==0)
+    { row_state[i] = 2;
+      gap_rows[n_gap++] = i;
+    }
+  }
+}
+
+
+/* PRINT USAGE MESSAGE AND EXIT. */
+
+void usage(void)
+{ fprintf(stderr,"Usage:  make-ru pchk-file gen-file\n");
+  exit(1);
+}
@@ -19,7 +19,9 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
+#include <pthread.h>
 
 #include "alloc.h"
 #include "intio.h"
@@ -50,7 +52,15 @@ mod2dense *mod2dense_allocate
 
   m->col = chk_alloc (m->n_cols, sizeof *m->col);
 
-  m->bits = chk_alloc(m->n_words*m->n_cols, sizeof *m->bits);
+  /* The bits are stored in aligned space, so XOR loops over columns can use
+     wide vector instructions. */
+
+  if (posix_memalign ((void **) &m->bits, mod2_align, 
+                      (size_t)m->n_words*m->n_cols*sizeof *m->bits) != 0)
+  { fprintf(stderr,"Ran out of memory (while allocating a dense matrix)\n");
+    exit(1);
+  }
+  memset (m->bits, 0, (size_t)m->n_words*m->n_cols*sizeof *m->bits);
 
   for (j = 0; j<m->n_cols; j++)
   { m->col[j] = m->bits + j*m->n_words;
@@ -202,15 +212,16 @@ void mod2dense_print
 /* WRITE A DENSE MOD2 MATRIX TO A FILE IN MACHINE-READABLE FORM.
 
    Data is written using intio_write, so that it will be readable on a machine
-   with a different byte-ordering.  At present, this assumes that the words 
-   used to pack bits into are no longer than 32 bits. */
+   with a different byte-ordering.  Bits are written in 32-bit pieces, low 
+   half of each word first, as many as are needed for the rows, so the file
+   is the same as when 32-bit words were used in memory. */
 
 int mod2dense_write     
 ( FILE *f, 
   mod2dense *m
 )
 { 
-  int j, k;
+  int j, k, n;
 
   intio_write(f,m->n_rows);
   if (ferror(f)) return 0;
@@ -218,10 +229,13 @@ int mod2dense_write
   intio_write(f,m->n_cols);
   if (ferror(f)) return 0;
 
+  n = (m->n_rows+31) >> 5;
+
   for (j = 0; j<mod2dense_cols(m); j++)
   {
-    for (k = 0; k<m->n_words; k++)
-    { intio_write(f,m->col[j][k]);
+    for (k = 0; k<n; k++)
+    { intio_write(f,(int)(uint32_t)(m->col[j][k/mod2_filewords] 
+                                     >> (32*(k%mod2_filewords))));
       if (ferror(f)) return 0;
     }
   }
@@ -238,7 +252,7 @@ mod2dense *mod2dense_read
 { 
   int n_rows, n_cols;
   mod2dense *m;
-  int j, k;
+  int j, k, n;
   
   n_rows = intio_read(f);
   if (feof(f) || ferror(f) || n_rows<=0) return 0;
@@ -248,10 +262,13 @@ mod2dense *mod2dense_read
 
   m = mod2dense_allocate(n_rows,n_cols);
 
+  n = (n_rows+31) >> 5;
+
   for (j = 0; j<mod2dense_cols(m); j++)
   {
-    for (k = 0; k<m->n_words; k++)
-    { m->col[j][k] = intio_read(f);
+    for (k = 0; k<n; k++)
+    { m->col[j][k/mod2_filewords] |= 
+        (mod2word)(uint32_t)intio_read(f) << (32*(k%mod2_filewords));
       if (feof(f) || ferror(f)) 
       { mod2dense_free(m);
         return 0;
@@ -360,7 +377,7 @@ void mod2dense_transpose
   for (j1 = 0; j1<mod2dense_cols(m); j1++)
   { 
     i2 = j1 >> mod2_wordsize_shift;
-    v = 1 << (j1 & mod2_wordsize_mask);
+    v = (mod2word)1 << (j1 & mod2_wordsize_mask);
 
     p = m->col[j1];
     k1 = 0;
@@ -409,10 +426,8 @@ void mod2dense_add
 /* MULTIPLY TWO DENSE MOD2 MATRICES. 
 
    The algorithm used runs faster if the second matrix (right operand of the
-   multiply) is sparse, but it is also appropriate for dense matrices.  This
-   procedure could be speeded up a bit by replacing the call of mod2dense_get
-   with in-line code that avoids division, but this doesn't seem worthwhile
-   at the moment. 
+   multiply) is sparse, but it is also appropriate for dense matrices.  The
+   1s in a column of the second matrix are found a word at a time.
 */
 
 void mod2dense_multiply 
@@ -421,7 +436,8 @@ void mod2dense_multiply
   mod2dense *r		/* Place to store result of multiply */
 )
 {
-  int i, j, k;
+  mod2word b, *s, *t;
+  int i, j, k, w;
 
   if (mod2dense_cols(m1)!=mod2dense_rows(m2) 
    || mod2dense_rows(m1)!=mod2dense_rows(r) 
@@ -440,10 +456,16 @@ void mod2dense_multiply
   mod2dense_clear(r);
 
   for (j = 0; j<mod2dense_cols(r); j++)
-  { for (i = 0; i<mod2dense_rows(m2); i++)
-    { if (mod2dense_get(m2,i,j))
-      { for (k = 0; k<r->n_words; k++)
-        { r->col[j][k] ^= m1->col[i][k];
+  { s = r->col[j];
+    for (w = 0; w<m2->n_words; w++)
+    { b = m2->col[j][w];
+      while (b!=0)
+      { i = (w<<mod2_wordsize_shift) + __builtin_ctzll(b);
+        if (i>=mod2dense_rows(m2)) break;
+        b &= b-1;
+        t = m1->col[i];
+        for (k = 0; k<r->n_words; k++)
+        { s[k] ^= t[k];
         }
       }
     }
@@ -472,7 +494,7 @@ int mod2dense_equal
   /* Form a mask that has 1s in the lower bit positions corresponding to
      bits that contain information in the last word of a matrix column. */
 
-  m = (1 << (mod2_wordsize - (w*mod2_wordsize-m1->n_rows))) - 1;
+  m = ~(mod2word)0 >> (w*mod2_wordsize-m1->n_rows);
   
   for (j = 0; j<mod2dense_cols(m1); j++)
   {
@@ -487,6 +509,267 @@ int mod2dense_equal
 }
 
 
+/* ELIMINATION WITH GROUPS OF PIVOTS.  The inversion procedures below do
+   Gauss-Jordan elimination on columns, but by the "Method of Four Russians":
+   pivots are chosen a group of up to mod2_group at a time, and the other 
+   columns are updated once per group rather than once per pivot.  
+
+   While a group is being formed, the pivot columns are kept reduced with 
+   respect to one another, and for every other column the bits it has in the
+   rows of the pivots so far are recorded in 'win'.  These bits say which 
+   pivots the column must be added to, so its bit in a new row after 
+   elimination can be found without changing it.  When the group is complete,
+   a table of the sums of all subsets of its pivot columns is made, and each 
+   other column has one entry from this table added to it.  This is done in 
+   parallel by mod2dense_threads threads, if that is more than one.
+
+   The result is exactly the same as eliminating with one pivot at a time.
+   Columns are referred to by their index in m->col (and r->col). */
+
+int mod2dense_threads = 1;	/* Number of threads to use for inversion */
+
+#define mod2_group 8		/* Maximum number of pivots in a group */
+
+#define mod2_thread_work 65536	/* Minimum words updated per group for using
+				   more than one thread */
+
+typedef struct 
+{ 
+  mod2dense *m, *r;		/* Matrices being operated on */
+  int k0;			/* Words of m before this are zero in pivots */
+
+  int n;			/* Number of pivots in the group so far */
+  int row[mod2_group];		/* Rows of these pivots */
+  int col[mod2_group];		/* Columns of these pivots */
+
+  unsigned *win;		/* Bits of each column in the pivot rows */
+
+  mod2word *tm, *tr;		/* Sums of subsets of pivot columns */
+
+  int n_threads;		/* Number of threads updating columns */
+  pthread_t *threads;		/* The threads, other than the calling one */
+  pthread_barrier_t start, done;/* Barriers for starting and ending updates */
+  int quit;			/* Set to tell the threads to finish */
+
+} mod2_elim;
+
+static void elim_update (mod2_elim *e, int t)
+{
+  mod2word *s, *tm, *tr;
+  int j, j0, j1, k, wm, wr;
+  unsigned v;
+
+  wm = e->m->n_words;
+  wr = e->r->n_words;
+
+  j0 = (long) mod2dense_cols(e->m) * t / e->n_threads;
+  j1 = (long) mod2dense_cols(e->m) * (t+1) / e->n_threads;
+
+  for (j = j0; j<j1; j++)
+  { v = e->win[j];
+    if (v==0) continue;
+    s = e->m->col[j];
+    tm = e->tm + v*wm;
+    for (k = e->k0; k<wm; k++) s[k] ^= tm[k];
+    s = e->r->col[j];
+    tr = e->tr + v*wr;
+    for (k = 0; k<wr; k++) s[k] ^= tr[k];
+  }
+}
+
+typedef struct { mod2_elim *e; int t; } elim_arg;
+
+static void *elim_thread (void *a)
+{
+  mod2_elim *e = ((elim_arg *)a)->e;
+  int t = ((elim_arg *)a)->t;
+
+  for (;;)
+  { pthread_barrier_wait(&e->start);
+    if (e->quit) break;
+    elim_update(e,t);
+    pthread_barrier_wait(&e->done);
+  }
+
+  free(a);
+  return 0;
+}
+
+static void elim_begin (mod2_elim *e, mod2dense *m, mod2dense *r)
+{
+  elim_arg *a;
+  int t;
+
+  e->m = m;
+  e->r = r;
+  e->k0 = 0;
+  e->n = 0;
+  e->quit = 0;
+
+  e->win = chk_alloc (mod2dense_cols(m), sizeof *e->win);
+  e->tm = chk_alloc ((1<<mod2_group) * m->n_words, sizeof *e->tm);
+  e->tr = chk_alloc ((1<<mod2_group) * r->n_words, sizeof *e->tr);
+
+  e->n_threads = 1;
+  if (mod2dense_threads>1 
+   && (double)mod2dense_cols(m)*(m->n_words+r->n_words) >= mod2_thread_work)
+  { e->n_threads = mod2dense_threads;
+  }
+
+  if (e->n_threads>1)
+  { pthread_barrier_init(&e->start,0,e->n_threads);
+    pthread_barrier_init(&e->done,0,e->n_threads);
+    e->threads = chk_alloc (e->n_threads-1, sizeof *e->threads);
+    for (t = 1; t<e->n_threads; t++)
+    { a = chk_alloc (1, sizeof *a);
+      a->e = e;
+      a->t = t;
+      if (pthread_create(&e->threads[t-1],0,elim_thread,a)!=0)
+      { fprintf(stderr,"mod2dense: Can't create thread\n");
+        exit(1);
+      }
+    }
+  }
+}
+
+static void elim_end (mod2_elim *e)
+{
+  int t;
+
+  if (e->n_threads>1)
+  { e->quit = 1;
+    pthread_barrier_wait(&e->start);
+    for (t = 1; t<e->n_threads; t++) 
+    { pthread_join(e->threads[t-1],0);
+    }
+    pthread_barrier_destroy(&e->start);
+    pthread_barrier_destroy(&e->done);
+    free(e->threads);
+  }
+
+  free(e->win);
+  free(e->tm);
+  free(e->tr);
+}
+
+/* Find the bit of column j in row i, as it will be after elimination with 
+   the pivots in the group so far. */
+
+static int elim_bit (mod2_elim *e, int i, int j)
+{
+  unsigned c;
+  int p;
+
+  c = 0;
+  for (p = 0; p<e->n; p++)
+  { c |= mod2_getbit (e->m->col[e->col[p]][i>>mod2_wordsize_shift],
+                      i&mod2_wordsize_mask) << p;
+  }
+
+  return mod2_getbit (e->m->col[j][i>>mod2_wordsize_shift],
+                      i&mod2_wordsize_mask) 
+          ^ (__builtin_popcount(e->win[j]&c) & 1);
+}
+
+/* Swap columns i and j, in both matrices. */
+
+static void elim_swap (mod2_elim *e, int i, int j)
+{
+  mod2word *t;
+  unsigned v;
+
+  t = e->m->col[i]; e->m->col[i] = e->m->col[j]; e->m->col[j] = t;
+  t = e->r->col[i]; e->r->col[i] = e->r->col[j]; e->r->col[j] = t;
+  v = e->win[i]; e->win[i] = e->win[j]; e->win[j] = v;
+}
+
+/* Update all columns other than the pivots, and start a new group. */
+
+static void elim_flush (mod2_elim *e)
+{
+  mod2word *tm, *tr, *pm, *pr;
+  int wm, wr, k, p, v;
+
+  if (e->n==0) return;
+
+  wm = e->m->n_words;
+  wr = e->r->n_words;
+
+  for (v = 1; v < 1<<e->n; v++)
+  { p = __builtin_ctz(v);
+    tm = e->tm + (v&(v-1))*wm;
+    tr = e->tr + (v&(v-1))*wr;
+    pm = e->m->col[e->col[p]];
+    pr = e->r->col[e->col[p]];
+    for (k = e->k0; k<wm; k++) e->tm[v*wm+k] = tm[k] ^ pm[k];
+    for (k = 0; k<wr; k++) e->tr[v*wr+k] = tr[k] ^ pr[k];
+  }
+
+  if (e->n_threads>1)
+  { pthread_barrier_wait(&e->start);
+    elim_update(e,0);
+    pthread_barrier_wait(&e->done);
+  }
+  else
+  { elim_update(e,0);
+  }
+
+  for (k = 0; k<mod2dense_cols(e->m); k++) e->win[k] = 0;
+
+  e->n = 0;
+}
+
+/* Make column j the pivot for row i, whose bit there after elimination must 
+   be one.  The column is reduced with the other pivots in the group, they 
+   are reduced with it, and the bits of other columns in row i are recorded.
+   The group is flushed if it is then full. */
+
+static void elim_pivot (mod2_elim *e, int i, int j)
+{
+  mod2word *s, *t;
+  int wm, wr, k, p, q, k0, b0;
+
+  wm = e->m->n_words;
+  wr = e->r->n_words;
+  k0 = i >> mod2_wordsize_shift;
+  b0 = i & mod2_wordsize_mask;
+
+  for (p = 0; p<e->n; p++)
+  { if (e->win[j]>>p & 1)
+    { s = e->m->col[j]; t = e->m->col[e->col[p]];
+      for (k = e->k0; k<wm; k++) s[k] ^= t[k];
+      s = e->r->col[j]; t = e->r->col[e->col[p]];
+      for (k = 0; k<wr; k++) s[k] ^= t[k];
+    }
+  }
+
+  for (p = 0; p<e->n; p++)
+  { if (mod2_getbit(e->m->col[e->col[p]][k0],b0))
+    { s = e->m->col[e->col[p]]; t = e->m->col[j];
+      for (k = e->k0; k<wm; k++) s[k] ^= t[k];
+      s = e->r->col[e->col[p]]; t = e->r->col[j];
+      for (k = 0; k<wr; k++) s[k] ^= t[k];
+    }
+  }
+
+  p = e->n;
+  e->row[p] = i;
+  e->col[p] = j;
+  e->n += 1;
+
+  for (k = 0; k<mod2dense_cols(e->m); k++)
+  { e->win[k] |= mod2_getbit(e->m->col[k][k0],b0) << p;
+  }
+  for (q = 0; q<e->n; q++) 
+  { e->win[e->col[q]] = 0;
+  }
+
+  if (e->n==mod2_group) 
+  { elim_flush(e);
+  }
+}
+
+
 /* INVERT A DENSE MOD2 MATRIX. */
 
 int mod2dense_invert 
@@ -494,8 +777,8 @@ int mod2dense_invert
   mod2dense *r		/* Place to store the inverse */
 )
 {
-  mod2word *s, *t;
-  int i, j, k, n, w, k0, b0;
+  mod2_elim e;
+  int i, j, n;
 
   if (mod2dense_rows(m)!=mod2dense_cols(m))
   { fprintf(stderr,"mod2dense_invert: Matrix to invert is not square\n");
@@ -509,7 +792,6 @@ int mod2dense_invert
   }
 
   n = mod2dense_rows(m);
-  w = m->n_words;
 
   if (mod2dense_rows(r)!=n || mod2dense_cols(r)!=n)
   { fprintf(stderr,
@@ -522,40 +804,31 @@ int mod2dense_invert
   { mod2dense_set(r,i,i,1);
   }
 
+  elim_begin(&e,m,r);
+
   for (i = 0; i<n; i++)
   { 
-    k0 = i >> mod2_wordsize_shift;
-    b0 = i & mod2_wordsize_mask;
+    if (e.n==0) e.k0 = i >> mod2_wordsize_shift;
 
     for (j = i; j<n; j++) 
-    { if (mod2_getbit(m->col[j][k0],b0)) break;
+    { if (elim_bit(&e,i,j)) break;
     }
 
-    if (j==n) return 0;
+    if (j==n) 
+    { elim_end(&e);
+      return 0;
+    }
 
     if (j!=i)
-    {
-      t = m->col[i];
-      m->col[i] = m->col[j];
-      m->col[j] = t;
-
-      t = r->col[i];
-      r->col[i] = r->col[j];
-      r->col[j] = t;
+    { elim_swap(&e,i,j);
     }
 
-    for (j = 0; j<n; j++)
-    { if (j!=i && mod2_getbit(m->col[j][k0],b0))
-      { s = m->col[j];
-        t = m->col[i];
-        for (k = k0; k<w; k++) s[k] ^= t[k];
-        s = r->col[j];
-        t = r->col[i];
-        for (k = 0; k<w; k++) s[k] ^= t[k];
-      }
-    }
+    elim_pivot(&e,i,i);
   }
 
+  elim_flush(&e);
+  elim_end(&e);
+
   return 1;
 }
 
@@ -569,8 +842,9 @@ int mod2dense_invert_selected
   int *cols		/* Set to indexes of columns used and not used */
 )
 {
-  mod2word *s, *t;
-  int i, j, k, n, n2, w, k0, b0, c, R;
+  mod2_elim e;
+  mod2word *s;
+  int i, j, k, n, n2, w, c, R;
 
   if (r==m)
   { fprintf(stderr, 
@@ -599,6 +873,8 @@ int mod2dense_invert_selected
   { cols[j] = j;
   }
 
+  elim_begin(&e,m,r);
+
   R = 0;
   i = 0;
 
@@ -606,11 +882,8 @@ int mod2dense_invert_selected
   { 
     while (i<n-R)
     {
-      k0 = rows[i] >> mod2_wordsize_shift;
-      b0 = rows[i] & mod2_wordsize_mask;
-
       for (j = i; j<n2; j++) 
-      { if (mod2_getbit(m->col[cols[j]][k0],b0)) break;
+      { if (elim_bit(&e,rows[i],cols[j])) break;
       }
 
       if (j<n2) break;
@@ -630,20 +903,14 @@ int mod2dense_invert_selected
 
     mod2dense_set(r,rows[i],c,1);
 
-    for (j = 0; j<n2; j++)
-    { if (j!=c && mod2_getbit(m->col[j][k0],b0))
-      { s = m->col[j];
-        t = m->col[c];
-        for (k = 0; k<w; k++) s[k] ^= t[k];
-        s = r->col[j];
-        t = r->col[c];
-        for (k = 0; k<w; k++) s[k] ^= t[k];
-      }
-    }
+    elim_pivot(&e,rows[i],c);
 
     i += 1;
   }
 
+  elim_flush(&e);
+  elim_end(&e);
+
   for (j = n-R; j<n; j++)
   { s = r->col[cols[j]];
     for (k = 0; k<w; k++) s[k] = 0;
@@ -662,8 +929,8 @@ int mod2dense_forcibly_invert
   int *a_col		/* Place to store column indexes of altered elements */
 )
 {
-  mod2word *s, *t;
-  int i, j, k, n, w, k0, b0;
+  mod2_elim e;
+  int i, j, n;
   int u, c;
 
   if (mod2dense_rows(m)!=mod2dense_cols(m))
@@ -679,7 +946,6 @@ int mod2dense_forcibly_invert
   }
 
   n = mod2dense_rows(m);
-  w = m->n_words;
 
   if (mod2dense_rows(r)!=n || mod2dense_cols(r)!=n)
   { fprintf(stderr,
@@ -697,48 +963,37 @@ int mod2dense_forcibly_invert
     a_col[i] = i;
   }
 
+  elim_begin(&e,m,r);
+
   for (i = 0; i<n; i++)
   { 
-    k0 = i >> mod2_wordsize_shift;
-    b0 = i & mod2_wordsize_mask;
+    if (e.n==0) e.k0 = i >> mod2_wordsize_shift;
 
     for (j = i; j<n; j++) 
-    { if (mod2_getbit(m->col[j][k0],b0)) break;
+    { if (elim_bit(&e,i,j)) break;
     }
 
     if (j==n)
     { j = i;
-      mod2dense_set(m,i,j,1);
+      (void) mod2dense_flip(m,i,j);  /* Bit after elimination becomes 1 */
       a_row[i] = i;
     }
 
     if (j!=i)
     { 
-      t = m->col[i];
-      m->col[i] = m->col[j];
-      m->col[j] = t;
-
-      t = r->col[i];
-      r->col[i] = r->col[j];
-      r->col[j] = t;
+      elim_swap(&e,i,j);
 
       u = a_col[i];
       a_col[i] = a_col[j];
       a_col[j] = u;
     }
 
-    for (j = 0; j<n; j++)
-    { if (j!=i && mod2_getbit(m->col[j][k0],b0))
-      { s = m->col[j];
-        t = m->col[i];
-        for (k = k0; k<w; k++) s[k] ^= t[k];
-        s = r->col[j];
-        t = r->col[i];
-        for (k = 0; k<w; k++) s[k] ^= t[k];
-      }
-    }
+    elim_pivot(&e,i,i);
   }
 
+  elim_flush(&e);
+  elim_end(&e);
+
   c = 0;
   for (i = 0; i<n; i++)
   { if (a_row[i]!=-1)
@@ -29,16 +29,23 @@
 */
 
 
-/* PACKING OF BITS INTO WORDS.  Bits are packed into 32-bit words, with
-   the low-order bit coming first. */
+/* PACKING OF BITS INTO WORDS.  Bits are packed into 64-bit words, with
+   the low-order bit coming first.  Files still hold them as 32-bit words,
+   written with the intio module, low half first. */
 
-typedef unsigned long mod2word;	/* Data type that holds packed bits */
+#include <stdint.h>
 
-#define mod2_wordsize 32	/* Number of bits that fit in a mod2word. Can't
-				   be increased without changing intio module */
+typedef uint64_t mod2word;	/* Data type that holds packed bits */
 
-#define mod2_wordsize_shift 5	/* Amount to shift by to divide by wordsize */
-#define mod2_wordsize_mask 0x1f /* What to and with to produce mod wordsize */
+#define mod2_wordsize 64	/* Number of bits that fit in a mod2word */
+
+#define mod2_wordsize_shift 6	/* Amount to shift by to divide by wordsize */
+#define mod2_wordsize_mask 0x3f /* What to and with to produce mod wordsize */
+
+#define mod2_filewords 2	/* Number of 32-bit words in files for each 
+				   mod2word */
+
+#define mod2_align 64		/* Alignment of storage for bits, in bytes */
 
 /* Extract the i'th bit of a mod2word. */
 
@@ -46,11 +53,11 @@ typedef unsigned long mod2word;	/* Data type that holds packed bits */
 
 /* Make a word like w, but with the i'th bit set to 1 (if it wasn't already). */
 
-#define mod2_setbit1(w,i) ((w)|(1<<(i))) 
+#define mod2_setbit1(w,i) ((w)|((mod2word)1<<(i))) 
 
 /* Make a word like w, but with the i'th bit set to 0 (if it wasn't already). */
 
-#define mod2_setbit0(w,i) ((w)&(~(1<<(i)))) 
+#define mod2_setbit0(w,i) ((w)&(~((mod2word)1<<(i)))) 
 
 
 /* STRUCTURE REPRESENTING A DENSE MATRIX.  These structures are dynamically
@@ -105,6 +112,8 @@ void mod2dense_multiply  (mod2dense *, mod2dense *, mod2dense *);
 
 int mod2dense_equal (mod2dense *, mod2dense *);
 
+extern int mod2dense_threads;	/* Number of threads used for inversion */
+
 int mod2dense_invert          (mod2dense *, mod2dense *);
 int mod2dense_forcibly_invert (mod2dense *, mod2dense *, int *, int *);
 int mod2dense_invert_selected (mod2dense *, mod2dense *, int *, int *);
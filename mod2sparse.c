@@ -19,6 +19,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 
 #include "alloc.h"
@@ -26,43 +27,77 @@
 #include "mod2sparse.h"
 
 
+/* ADD A BLOCK OF ENTRIES TO A MATRIX.  The entries are put on the free list
+   so that they will be used in order. */
+
+static void add_block
+( mod2sparse *m,
+  int n			/* Number of entries in block */
+)
+{ 
+  mod2block *b;
+  int k;
+
+  b = chk_alloc (1, sizeof *b + n * sizeof *b->entry);
+
+  b->next = m->blocks;
+  b->n_entries = n;
+  m->blocks = b;
+
+  for (k = n-1; k>=0; k--)
+  { b->entry[k].left = m->next_free;
+    m->next_free = &b->entry[k];
+  }
+
+  m->n_free += n;
+  m->n_alloc += n;
+}
+
+
 /* ALLOCATE AN ENTRY WITHIN A MATRIX.  This local procedure is used to
    allocate a new entry, representing a non-zero element, within a given
    matrix.  Entries in this matrix that were previously allocated and
    then freed are re-used.  If there are no such entries, a new block
-   of entries is allocated. */
+   of entries is allocated, as big as all the blocks before it. */
 
 static mod2entry *alloc_entry
 ( mod2sparse *m
 )
 { 
-  mod2block *b;
   mod2entry *e;
-  int k;
 
   if (m->next_free==0)
-  { 
-    b = chk_alloc (1, sizeof *b);
-
-    b->next = m->blocks;
-    m->blocks = b;
-
-    for (k = 0; k<Mod2sparse_block; k++)
-    { b->entry[k].left = m->next_free;
-      m->next_free = &b->entry[k];
-    }
+  { add_block (m, m->n_alloc<Mod2sparse_block ? Mod2sparse_block : m->n_alloc);
   }
 
   e = m->next_free;
   m->next_free = e->left;
-
-  e->pr = 0;
-  e->lr = 0;
+  m->n_free -= 1;
 
   return e;
 }
 
 
+/* RESERVE SPACE FOR ENTRIES IN A MATRIX.  Makes sure that n more entries
+   can be inserted without allocating more memory, adding a block of just 
+   the size needed if necessary. */
+
+void mod2sparse_reserve
+( mod2sparse *m,	/* Matrix to reserve space in */
+  int n			/* Number of entries to make room for */
+)
+{
+  if (n<0)
+  { fprintf(stderr,"mod2sparse_reserve: Invalid number of entries\n");
+    exit(1);
+  }
+
+  if (n>m->n_free)
+  { add_block (m, n-m->n_free);
+  }
+}
+
+
 /* ALLOCATE SPACE FOR A SPARSE MOD2 MATRIX.  */
 
 mod2sparse *mod2sparse_allocate
@@ -89,6 +124,10 @@ mod2sparse *mod2sparse_allocate
 
   m->blocks = 0;
   m->next_free = 0;
+  m->n_free = 0;
+  m->n_alloc = 0;
+
+  m->frozen = 0;
 
   for (i = 0; i<n_rows; i++)
   { e = &m->rows[i];
@@ -106,6 +145,115 @@ mod2sparse *mod2sparse_allocate
 }
 
 
+/* FREEZE A SPARSE MOD2 MATRIX.  The entries are copied into a single new
+   block in order of row, and then column, and linked up again, after which 
+   the old blocks are freed.  Any pointers to entries held by the caller 
+   are therefore no longer valid.  Freezing a frozen matrix does nothing. */
+
+void mod2sparse_freeze
+( mod2sparse *m		/* Matrix to freeze */
+)
+{
+  mod2block *b, *ob;
+  mod2entry *e, *f, *h;
+  int M, N, n, i, j, k;
+  int *next;
+
+  if (m->frozen) return;
+
+  M = mod2sparse_rows(m);
+  N = mod2sparse_cols(m);
+
+  /* Count the entries in each row and column. */
+
+  m->row_start = chk_alloc (M+1, sizeof *m->row_start);
+  m->col_start = chk_alloc (N+1, sizeof *m->col_start);
+
+  for (i = 0; i<M; i++)
+  { for (e = mod2sparse_first_in_row(m,i);
+         !mod2sparse_at_end(e);
+         e = mod2sparse_next_in_row(e))
+    { m->row_start[i+1] += 1;
+      m->col_start[mod2sparse_col(e)+1] += 1;
+    }
+  }
+
+  for (i = 0; i<M; i++) m->row_start[i+1] += m->row_start[i];
+  for (j = 0; j<N; j++) m->col_start[j+1] += m->col_start[j];
+
+  n = m->row_start[M];
+
+  /* Copy the entries in order of row, and put them in the lists for their
+     columns, which will then be in order of row too. */
+
+  b = chk_alloc (1, sizeof *b + n * sizeof *b->entry);
+  b->next = 0;
+  b->n_entries = n;
+
+  m->col_entry = chk_alloc (n>0 ? n : 1, sizeof *m->col_entry);
+
+  next = chk_alloc (N, sizeof *next);
+  for (j = 0; j<N; j++) next[j] = m->col_start[j];
+
+  k = 0;
+  for (i = 0; i<M; i++)
+  { for (e = mod2sparse_first_in_row(m,i);
+         !mod2sparse_at_end(e);
+         e = mod2sparse_next_in_row(e))
+    { f = &b->entry[k];
+      f->row = i;
+      f->col = mod2sparse_col(e);
+      m->col_entry[next[f->col]++] = k;
+      k += 1;
+    }
+  }
+
+  free(next);
+
+  /* Link the new entries by row and by column. */
+
+  for (i = 0; i<M; i++)
+  { h = &m->rows[i];
+    h->left = h->right = h;
+    for (k = m->row_start[i]; k<m->row_start[i+1]; k++)
+    { f = &b->entry[k];
+      f->left = h->left;
+      f->right = h;
+      f->left->right = f;
+      h->left = f;
+    }
+  }
+
+  for (j = 0; j<N; j++)
+  { h = &m->cols[j];
+    h->up = h->down = h;
+    for (k = m->col_start[j]; k<m->col_start[j+1]; k++)
+    { f = &b->entry[m->col_entry[k]];
+      f->up = h->up;
+      f->down = h;
+      f->up->down = f;
+      h->up = f;
+    }
+  }
+
+  /* Replace the old blocks by the new one. */
+
+  while (m->blocks!=0)
+  { ob = m->blocks;
+    m->blocks = ob->next;
+    free(ob);
+  }
+
+  m->blocks = b;
+  m->next_free = 0;
+  m->n_free = 0;
+  m->n_alloc = n;
+
+  m->entries = b->entry;
+  m->frozen = 1;
+}
+
+
 /* FREE SPACE OCCUPIED BY A SPARSE MOD2 MATRIX. */
 
 void mod2sparse_free
@@ -117,11 +265,22 @@ void mod2sparse_free
   free(m->rows);
   free(m->cols);
 
+  if (m->frozen)
+  { free(m->row_start);
+    free(m->col_start);
+    free(m->col_entry);
+    m->frozen = 0;
+  }
+
   while (m->blocks!=0)
   { b = m->blocks;
     m->blocks = b->next;
     free(b);
   }
+
+  m->next_free = 0;
+  m->n_free = 0;
+  m->n_alloc = 0;
 }
 
 
@@ -135,6 +294,11 @@ void mod2sparse_clear
   mod2entry *e;
   int i, j;
 
+  if (r->frozen)
+  { fprintf(stderr,"mod2sparse_clear: Matrix is frozen\n");
+    exit(1);
+  }
+
   for (i = 0; i<mod2sparse_rows(r); i++)
   { e = &r->rows[i];
     e->left = e->right = e->up = e->down = e;
@@ -150,6 +314,10 @@ void mod2sparse_clear
     r->blocks = b->next;
     free(b);
   }
+
+  r->next_free = 0;
+  r->n_free = 0;
+  r->n_alloc = 0;
 }
 
 
@@ -160,8 +328,8 @@ void mod2sparse_copy
   mod2sparse *r		/* Place to store copy of matrix */
 )
 {
-  mod2entry *e, *f;
-  int i;
+  mod2entry *e;
+  int i, n;
 
   if (mod2sparse_rows(m)>mod2sparse_rows(r) 
    || mod2sparse_cols(m)>mod2sparse_cols(r))
@@ -171,14 +339,18 @@ void mod2sparse_copy
 
   mod2sparse_clear(r);
 
+  n = 0;
+  for (i = 0; i<mod2sparse_rows(m); i++)
+  { n += mod2sparse_count_row(m,i);
+  }
+  mod2sparse_reserve(r,n);
+
   for (i = 0; i<mod2sparse_rows(m); i++)
   {
     e = mod2sparse_first_in_row(m,i); 
 
     while (!mod2sparse_at_end(e))
-    { f = mod2sparse_insert(r,e->row,e->col);
-      f->lr = e->lr;
-      f->pr = e->pr;
+    { mod2sparse_insert(r,e->row,e->col);
       e = mod2sparse_next_in_row(e);
     }
   }
@@ -333,7 +505,9 @@ int mod2sparse_write
 }
 
 
-/* READ A SPARSE MOD2 MATRIX STORED IN MACHINE-READABLE FORM FROM A FILE. */
+/* READ A SPARSE MOD2 MATRIX STORED IN MACHINE-READABLE FORM FROM A FILE.
+   The values are read into a buffer first, so that space for all the 
+   entries can be allocated at once. */
 
 mod2sparse *mod2sparse_read
 ( FILE *f
@@ -342,6 +516,8 @@ mod2sparse *mod2sparse_read
   int n_rows, n_cols;
   mod2sparse *m;
   int v, row, col;
+  int *buf, *nbuf, n_buf, max_buf;
+  int k, n;
 
   n_rows = intio_read(f);
   if (feof(f) || ferror(f) || n_rows<=0) return 0;
@@ -349,17 +525,47 @@ mod2sparse *mod2sparse_read
   n_cols = intio_read(f);
   if (feof(f) || ferror(f) || n_cols<=0) return 0;
 
+  max_buf = 1024;
+  buf = chk_alloc (max_buf, sizeof *buf);
+  n_buf = 0;
+
+  for (;;)
+  { 
+    v = intio_read(f);
+    if (feof(f) || ferror(f)) 
+    { free(buf);
+      return 0;
+    }
+
+    if (n_buf==max_buf)
+    { nbuf = chk_alloc (2*max_buf, sizeof *nbuf);
+      memcpy (nbuf, buf, max_buf * sizeof *buf);
+      free(buf);
+      buf = nbuf;
+      max_buf *= 2;
+    }
+    buf[n_buf++] = v;
+
+    if (v==0) break;
+  }
+
+  n = 0;
+  for (k = 0; k<n_buf; k++)
+  { if (buf[k]>0) n += 1;
+  }
+
   m = mod2sparse_allocate(n_rows,n_cols);
+  mod2sparse_reserve(m,n);
 
   row = -1;
 
-  for (;;)
+  for (k = 0; ; k++)
   {
-    v = intio_read(f);
-    if (feof(f) || ferror(f)) break;
+    v = buf[k];
 
     if (v==0)
-    { return m;
+    { free(buf);
+      return m;
     }
     else if (v<0) 
     { row = -v-1;
@@ -375,6 +581,7 @@ mod2sparse *mod2sparse_read
 
   /* Error if we get here. */
 
+  free(buf);
   mod2sparse_free(m);
   return 0;   
 }
@@ -455,6 +662,11 @@ mod2entry *mod2sparse_insert
     exit(1);
   }
 
+  if (m->frozen)
+  { fprintf(stderr,"mod2sparse_insert: Matrix is frozen\n");
+    exit(1);
+  }
+
   /* Find old entry and return it, or allocate new entry and insert into row. */
 
   re = mod2sparse_last_in_row(m,row);
@@ -549,6 +761,11 @@ void mod2sparse_delete
     exit(1);
   }
 
+  if (m->frozen)
+  { fprintf(stderr,"mod2sparse_delete: Matrix is frozen\n");
+    exit(1);
+  }
+
   if (e->row<0 || e->col<0)
   { fprintf(stderr,"mod2sparse_delete: Trying to delete a header entry\n");
     exit(1);
@@ -562,6 +779,7 @@ void mod2sparse_delete
  
   e->left = m->next_free;
   m->next_free = e;
+  m->n_free += 1;
 }
 
 
@@ -613,7 +831,7 @@ void mod2sparse_transpose
 )
 {
   mod2entry *e;
-  int i;
+  int i, n;
 
   if (mod2sparse_rows(m)!=mod2sparse_cols(r) 
    || mod2sparse_cols(m)!=mod2sparse_rows(r))
@@ -630,6 +848,12 @@ void mod2sparse_transpose
 
   mod2sparse_clear(r);
 
+  n = 0;
+  for (i = 0; i<mod2sparse_rows(m); i++)
+  { n += mod2sparse_count_row(m,i);
+  }
+  mod2sparse_reserve(r,n);
+
   for (i = 0; i<mod2sparse_rows(m); i++)
   {
     e = mod2sparse_first_in_row(m,i);
@@ -28,10 +28,25 @@
 /* DATA STRUCTURES USED TO STORE A SPARSE MATRIX.  Non-zero entries (ie, 1s)
    are represented by nodes that are doubly-linked both by row and by column,
    with the headers for these lists being kept in arrays.  Nodes are allocated
-   in blocks to reduce time and space overhead.  Freed nodes are kept for
-   reuse in the same matrix, rather than being freed for other uses, except 
-   that they are all freed when the matrix is cleared to all zeros by the
-   mod2sparse_clear procedure, or copied into by mod2sparse_copy. 
+   from blocks that are part of the matrix, with each new block being as big 
+   as all those before it, so that a matrix built up by insertions uses few 
+   blocks, and a matrix whose size is known (as when it is read or copied) 
+   uses just one.  Freed nodes are kept for reuse in the same matrix, rather 
+   than being freed for other uses, except that they are all freed when the 
+   matrix is cleared to all zeros by the mod2sparse_clear procedure, or 
+   copied into by mod2sparse_copy. 
+
+   Nodes hold only the structure of the matrix.  Values associated with 
+   entries, such as the messages passed when decoding, are kept by the user 
+   in separate arrays (see decgraph.h), which are both smaller and faster 
+   to go through than values stored in the nodes would be.
+
+   A matrix that will not change further can be frozen by mod2sparse_freeze.
+   Its entries are then moved into a single block, in order of row and then
+   column, so that going along a row goes through consecutive memory, and
+   arrays indexing the entries by row and column are set up.  Entries keep
+   their links, so the usual macros still work.  A frozen matrix may not be
+   changed, or cleared or copied into.
 
    Direct access to these structures should be avoided except in low-level
    routines.  Use the macros and procedures defined below instead. */
@@ -45,19 +60,18 @@ typedef struct mod2entry /* Structure representing a non-zero entry, or
   struct mod2entry *left, *right,  /* Pointers to entries adjacent in row  */
                    *up, *down;     /*   and column, or to headers.  Free   */
                                    /*   entries are linked by 'left'.      */
-
-  double pr, lr;	  /* Probability and likelihood ratios - not used  */
-			  /*   by the mod2sparse module itself             */
 } mod2entry;
 
-#define Mod2sparse_block 10  /* Number of entries to block together for
-                                memory allocation */
+#define Mod2sparse_block 64  /* Smallest number of entries to block together
+                                for memory allocation */
 
 typedef struct mod2block /* Block of entries allocated all at once */
 {
   struct mod2block *next;  /* Next block that has been allocated */
 
-  mod2entry entry[Mod2sparse_block]; /* Entries in this block */
+  int n_entries;	   /* Number of entries in this block */
+
+  mod2entry entry[];	   /* Entries in this block */
 
 } mod2block;
 
@@ -71,6 +85,15 @@ typedef struct		/* Representation of a sparse matrix */
 
   mod2block *blocks;	  /* Blocks that have been allocated */
   mod2entry *next_free;	  /* Next free entry */
+  int n_free;		  /* Number of free entries */
+  int n_alloc;		  /* Number of entries in all blocks */
+
+  int frozen;		  /* Whether the matrix has been frozen; if so: */
+  mod2entry *entries;	  /*   Entries, in order of row, then column */
+  int *row_start;	  /*   Index of first entry in each row, n_rows+1 long */
+  int *col_start;	  /*   Index into col_entry for each column, n_cols+1 
+                               long */
+  int *col_entry;	  /*   Index of each entry of a column, in order of row */
 
 } mod2sparse;
 
@@ -100,6 +123,24 @@ typedef struct		/* Representation of a sparse matrix */
 #define mod2sparse_cols(m) ((m)->n_cols)  /* in a matrix                      */
 
 
+/* MACROS FOR FROZEN MATRICES.  Entries of a frozen matrix are numbered from
+   0 in order of row, and then column.  The entries of row i are numbered 
+   from mod2sparse_row_start(m,i) to mod2sparse_row_start(m,i+1)-1.  Those of 
+   column j, in order of row, are mod2sparse_col_entry(m,k) for k from
+   mod2sparse_col_start(m,j) to mod2sparse_col_start(m,j+1)-1.  These macros
+   must not be used for a matrix that is not frozen. */
+
+#define mod2sparse_frozen(m) ((m)->frozen)    /* See if a matrix is frozen   */
+
+#define mod2sparse_entry(m,k) (&(m)->entries[k])  /* Get an entry from its   */
+#define mod2sparse_index(m,e) ((int)((e)-(m)->entries)) /* number, or the    */
+                                                  /* reverse               */
+
+#define mod2sparse_row_start(m,i) ((m)->row_start[i]) /* Get at the entries  */
+#define mod2sparse_col_start(m,j) ((m)->col_start[j]) /* of a row or column  */
+#define mod2sparse_col_entry(m,k) ((m)->col_entry[k])
+
+
 /* POSSIBLE LU DECOMPOSITION STRATEGIES.  For use with mod2sparse_decomp. */
 
 typedef enum 
@@ -113,6 +154,8 @@ typedef enum
 
 mod2sparse *mod2sparse_allocate (int, int);
 void mod2sparse_free            (mod2sparse *);
+void mod2sparse_reserve         (mod2sparse *, int);
+void mod2sparse_freeze          (mod2sparse *);
 
 void mod2sparse_clear    (mod2sparse *);
 void mod2sparse_copy     (mod2sparse *, mod2sparse *);
@@ -35,14 +35,18 @@ mod2sparse *H;		/* Parity check matrix */
 int M;			/* Number of rows in parity check matrix */
 int N;			/* Number of columns in parity check matrix */
 
-char type;		/* Type of generator matrix representation (s/d/m) */
+char type;		/* Type of generator matrix representation (s/d/m/r) */
 int *cols;		/* Ordering of columns in generator matrix */
 
 mod2sparse *L, *U;	/* Sparse LU decomposition, if type=='s' */
-int *rows;		/* Ordering of rows in generator matrix (type 's') */
+int *rows;		/* Ordering of rows in generator matrix (types 's' 
+			   and 'r') */
 
 mod2dense *G;		/* Dense or mixed representation of generator matrix,
-			   if type=='d' or type=='m' */
+			   if type=='d' or type=='m', or inverse of the gap 
+			   matrix if type=='r' */
+
+int gap;		/* Size of the gap, if type=='r' */
 
 
 /* READ PARITY CHECK MATRIX.  Sets the H, M, and N global variables.  If an
@@ -73,6 +77,11 @@ void read_pchk
     exit(1);
   }
 
+  /* The matrix is never changed after this, so it's frozen, to make going
+     through it faster. */
+
+  mod2sparse_freeze(H);
+
   M = mod2sparse_rows(H);
   N = mod2sparse_cols(H);
 
@@ -156,6 +165,9 @@ void read_gen
   
         if (mod2sparse_rows(L)!=M || mod2sparse_cols(L)!=M) goto garbled;
         if (mod2sparse_rows(U)!=M || mod2sparse_cols(U)<M) goto garbled;
+
+        mod2sparse_freeze(L);
+        mod2sparse_freeze(U);
        
         break;
       }
@@ -178,6 +190,25 @@ void read_gen
         break;
       }
   
+      case 'r':
+      {
+        for (i = 0; i<M; i++)
+        { rows[i] = intio_read(f);
+          if (feof(f) || ferror(f)) goto error;
+        }
+
+        gap = intio_read(f);
+        if (feof(f) || ferror(f)) goto error;
+        if (gap<0 || gap>M) goto garbled;
+
+        if (gap>0)
+        { if ((G = mod2dense_read(f)) == 0) goto error;
+          if (mod2dense_rows(G)!=gap || mod2dense_cols(G)!=gap) goto garbled;
+        }
+
+        break;
+      }
+  
       default: 
       { fprintf(stderr,
          "Unknown type of generator matrix in file %s\n",gen_file);
@@ -25,10 +25,14 @@ extern char type;	/* Type of generator matrix representation */
 extern int *cols;	/* Ordering of columns in generator matrix */
 
 extern mod2sparse *L, *U; /* Sparse LU decomposition, if type=='s' */
-extern int *rows;	  /* Ordering of rows in generator matrix (type 's') */
+extern int *rows;	  /* Ordering of rows in generator matrix (types 's'
+			     and 'r') */
 
 extern mod2dense *G;	/* Dense or mixed representation of generator matrix,
-			   if type=='d' or type=='m' */
+			   if type=='d' or type=='m', or inverse of the gap 
+			   matrix if type=='r' */
+
+extern int gap;		/* Size of the gap, if type=='r' */
 
 
 /* PROCEDURES FOR READING DATA. */
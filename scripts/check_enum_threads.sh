@@ -0,0 +1,54 @@
+#!/bin/bash
+if [ "$#" -gt 1 ]; then
+	echo "Checks that decoding by enumeration gives the same result with one thread as with several"
+	echo "usage: ./check_enum_threads.sh [ threads ]"
+	exit 1
+fi
+
+threads=${1:-4}
+dir=$(mktemp -d)
+trap 'rm -rf $dir' EXIT
+
+# A random 14 by 32 parity check matrix, with three checks on each bit, and
+# received blocks with 15% of their bits flipped.
+
+python3 - $dir <<'EOF'
+import random, struct, sys
+random.seed(1)
+M, N = 14, 32
+rows = [set() for i in range(M)]
+for j in range(N):
+    for k in range(3):
+        rows[random.randrange(M)].add(j)
+for r in rows:
+    while len(r)<2:
+        r.add(random.randrange(N))
+w = lambda f, v: f.write(struct.pack("<i", v))
+with open(sys.argv[1]+"/code.pchk", "wb") as f:
+    w(f, (ord('P')<<8)+0x80); w(f, M); w(f, N)
+    for i in range(M):
+        w(f, -(i+1))
+        for j in sorted(rows[i]):
+            w(f, j+1)
+    w(f, 0)
+with open(sys.argv[1]+"/received", "w") as f:
+    for b in range(100):
+        f.write("".join("1" if random.random()<0.15 else "0" for j in range(N))+"\n")
+EOF
+
+./make-ru $dir/code.pchk $dir/code.gen 2>/dev/null || exit 1
+
+status=0
+for method in enum-block enum-bit; do
+	for j in 1 $threads; do
+		./decode -a -j $j $dir/code.pchk $dir/received $dir/$j.dec $dir/$j.bp \
+		  bsc 0.15 $method $dir/code.gen 2>/dev/null || exit 1
+	done
+	if cmp -s $dir/1.dec $dir/$threads.dec && cmp -s $dir/1.bp $dir/$threads.bp; then
+		echo "$method: same with 1 and $threads threads"
+	else
+		echo "$method: DIFFERENT with 1 and $threads threads"
+		status=1
+	fi
+done
+exit $status
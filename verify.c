@@ -43,11 +43,14 @@ int main
 
   char *sblk, *cblk, *chks;
   int seof, ceof;
-  int srcerr, chkerr, bit_errs;
-  int i, n;
+  int packed, spacked;
+  int srcerr, chkerr;
+  long bit_errs;
+  long n;
+  int i;
   FILE *srcf, *codef;
 
-  int tot_srcerrs, tot_chkerrs, tot_botherrs;
+  long tot_srcerrs, tot_chkerrs, tot_botherrs;
 
   /* Look at arguments. */
 
@@ -89,6 +92,7 @@ int main
   /* Read parity check file. */
 
   read_pchk(pchk_file);
+  check_setup(H);
 
   if (N<=M)
   { fprintf(stderr,
@@ -111,8 +115,12 @@ int main
     exit(1);
   }
 
+  packed = blockio_read_header(codef,N);
+
   /* Open source file to verify against, if given. */
 
+  spacked = 0;
+
   if (source_file!=0)
   { 
     srcf = open_file_std(source_file,"r");
@@ -120,6 +128,8 @@ int main
     { fprintf(stderr,"Can't open source file: %s\n",source_file);
       exit(1);
     }
+
+    spacked = blockio_read_header(srcf,N-M);
   }
 
   sblk = chk_alloc (N-M, sizeof *sblk);
@@ -152,15 +162,17 @@ int main
   { 
     /* Read block from coded file. */
     
-    if (blockio_read(codef,cblk,N)==EOF) 
+    if ((packed ? blockio_read_packed(codef,cblk,N)
+                : blockio_read(codef,cblk,N))==EOF) 
     { ceof = 1;
     }
 
     /* Read block from source file, if given. */
 
     if (source_file!=0 && !ceof && !seof)
-    { if (blockio_read(srcf,sblk,N-M)==EOF) 
-      { fprintf(stderr,"Warning: Not enough source blocks (only %d)\n",n);
+    { if ((spacked ? blockio_read_packed(srcf,sblk,N-M)
+                   : blockio_read(srcf,sblk,N-M))==EOF) 
+      { fprintf(stderr,"Warning: Not enough source blocks (only %ld)\n",n);
         seof = 1;
       }
     }
@@ -200,10 +212,10 @@ int main
 
     if (table)
     { if (gen_file!=0)
-      { printf("%6d %7d %7d\n",n,chkerr,srcerr);
+      { printf("%6ld %7d %7d\n",n,chkerr,srcerr);
       }
       else
-      { printf("%6d %7d\n",n,chkerr);
+      { printf("%6ld %7d\n",n,chkerr);
       }
     }
 
@@ -223,15 +235,15 @@ int main
 
   if (gen_file!=0)
   { fprintf(stderr,
-     "Block counts: tot %d, with chk errs %d, with src errs %d, both %d\n",
+     "Block counts: tot %ld, with chk errs %ld, with src errs %ld, both %ld\n",
       n, tot_chkerrs, tot_srcerrs, tot_botherrs);
     fprintf(stderr,
      "Bit error rate (on message bits only): %.3e\n", 
-      (double)bit_errs/(n*(N-M)));
+      (double)bit_errs/((double)n*(N-M)));
   }
   else
   { fprintf (stderr, 
-     "Block counts: tot %d, with chk errs %d\n", n, tot_chkerrs);
+     "Block counts: tot %ld, with chk errs %ld\n", n, tot_chkerrs);
   }
 
   return 0;
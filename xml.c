@@ -21,9 +21,12 @@
 
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <libxml/xmlreader.h>
 
+#include "xml.h"
+
 #ifdef LIBXML_READER_ENABLED
 
 /**
@@ -83,6 +86,29 @@ void parse_meta(xmlTextReaderPtr reader,char meta_tags[64][32], char meta_values
 
 }
 
+/**
+ * copy_value:
+ * @dest: where to store the value, with room for max characters and a null
+ * @value: the #text value of an element
+ * @max: the longest value allowed
+ * @what: the name of the element, for the error message
+ *
+ * Copy the value of an element of a block, exiting if it is too long
+ */
+
+static void copy_value(char *dest, const xmlChar *value, int max, const char *what)
+{
+	if (value == NULL) value = BAD_CAST "";
+
+	if (xmlStrlen(value) > max) {
+		fprintf(stderr, "%s of block is too long (%d characters, at most %d allowed)\n",
+			what, xmlStrlen(value), max);
+		exit(1);
+	}
+
+	strcpy(dest, (const char *) value);
+}
+
 void parse_block(xmlTextReaderPtr reader,char *header_version, char *pos, char *header_checksum,
 		char *data, char *data_checksum, char *footer_version)
 {
@@ -103,20 +129,20 @@ void parse_block(xmlTextReaderPtr reader,char *header_version, char *pos, char *
 					//Get the #text element value
 					ret = xmlTextReaderRead(reader);
 					parse_node(reader, &name, &value, &type);
-					strcpy(header_version, value);
+					copy_value(header_version, value, Xml_max_version, "Version");
 					//Get pass the closing element
 					ret = xmlTextReaderRead(reader);
 				}
 				else if (!xmlStrcmp(name, (const xmlChar *)"Position")){
 					ret = xmlTextReaderRead(reader);
 					parse_node(reader, &name, &value, &type);
-					strcpy(pos, value);
+					copy_value(pos, value, Xml_max_pos, "Position");
 					ret = xmlTextReaderRead(reader);
 				}
 				else if (!xmlStrcmp(name, (const xmlChar *)"Header_Checksum")){
 					ret = xmlTextReaderRead(reader);
 					parse_node(reader, &name, &value, &type);
-					strcpy(header_checksum, value);
+					copy_value(header_checksum, value, Xml_max_checksum, "Header_Checksum");
 					ret = xmlTextReaderRead(reader);
 				}
 				ret = xmlTextReaderRead(reader);
@@ -126,7 +152,7 @@ void parse_block(xmlTextReaderPtr reader,char *header_version, char *pos, char *
 		else if ((!xmlStrcmp(name, (const xmlChar *)"Data"))) {
 			ret = xmlTextReaderRead(reader);
 			parse_node(reader, &name, &value, &type);
-			strcpy(data, value);
+			copy_value(data, value, Xml_max_data, "Data");
 			ret = xmlTextReaderRead(reader);
 		}
 		else if ((!xmlStrcmp(name, (const xmlChar *)"Footer"))) {
@@ -136,13 +162,13 @@ void parse_block(xmlTextReaderPtr reader,char *header_version, char *pos, char *
 				if (!xmlStrcmp(name, (const xmlChar *)"Data_Checksum")){
 					ret = xmlTextReaderRead(reader);
 					parse_node(reader, &name, &value, &type);
-					strcpy(data_checksum, value);
+					copy_value(data_checksum, value, Xml_max_checksum, "Data_Checksum");
 					ret = xmlTextReaderRead(reader);
 				}
 				else if (!xmlStrcmp(name, (const xmlChar *)"Version")){
 					ret = xmlTextReaderRead(reader);
 					parse_node(reader, &name, &value, &type);
-					strcpy(footer_version, value);
+					copy_value(footer_version, value, Xml_max_version, "Version");
 					ret = xmlTextReaderRead(reader);
 				}
 				ret = xmlTextReaderRead(reader);
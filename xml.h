@@ -21,6 +21,15 @@
 
 #include <libxml/xmlreader.h>
 
+/* Longest values allowed for the parts of a block, in characters (bits, or
+   bases when in DNA), not counting the terminating null.  Positions can
+   have up to 62 bits, as written by int2bin_evenpad for a long. */
+
+#define Xml_max_version 64
+#define Xml_max_pos 62
+#define Xml_max_checksum 32
+#define Xml_max_data 2048
+
 void parse_node(xmlTextReaderPtr ,const xmlChar **,const xmlChar **, int *);
 
 void parse_meta(xmlTextReaderPtr ,char [][32], char [][1024]);